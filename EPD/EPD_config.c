@@ -1,41 +1,223 @@
+#include <stddef.h>
 #include <string.h>
 #include "nordic_common.h"
 #include "fds.h"
+#include "app_error.h"
 #include "app_scheduler.h"
+#include "app_timer.h"
+#include "nrf_pwr_mgmt.h"
 #include "EPD_config.h"
+#include "main.h"
 #include "nrf_log.h"
 
 #define CONFIG_FILE_ID 0x0000
 #define CONFIG_REC_KEY 0x0001
 
+#define CONFIG_REC_WORDS      BYTES_TO_WORDS(sizeof(epd_config_t))
+#define CONFIG_MIN_FREE_WORDS (2 * (CONFIG_REC_WORDS + 3)) // room for two records with their 3 word headers
+#define CONFIG_WRITE_DELAY    TIMER_TICKS(5000)            // quiet period before a changed config is persisted
+#define OP_TIMEOUT            TIMER_TICKS(3000)            // longest wait for a layer or holiday write, delete or GC
+
+#define LAYER_FILE_ID 0x0001
+#define LAYER_REC_KEY 0x0001
+// The layer is the recorded display list of the month (about 800 words at 400x300), not a bitmap: a
+// compressed three-colour image would not fit the data pages below. FDS gives it one virtual page minus
+// the page tag, the record header and room for the config: about 970 words of the single 4 KB data page
+// on nRF52 (S112), about 200 words of a 1 KB page on nRF51 (S130), where layers are never saved. The
+// holidays share the page and evict the layer when they need the room.
+#define LAYER_MAX_WORDS (FDS_VIRTUAL_PAGE_SIZE - 2 - 3 - CONFIG_MIN_FREE_WORDS)
+
+#define HOLIDAY_FILE_ID   0x0002                          // one record per year, keyed by the year
+#define HOLIDAY_REC_WORDS BYTES_TO_WORDS(sizeof(epd_holidays_t))
+#define HOLIDAY_MAX_YEARS 4                               // the earliest year is dropped to make room for another
+
+static epd_config_t *m_config;                            // config to be persisted
+static uint32_t m_config_shadow[CONFIG_REC_WORDS];         // copy handed over to FDS while writing
+static volatile bool m_config_dirty = false;               // config changed since the last write
+static volatile bool m_config_busy = false;                // FDS write, delete or GC in progress
+static bool m_config_clear_pending = false;                // delete the record once FDS is idle
+static bool m_config_gc_done = false;                      // GC already tried for this write
+static bool m_config_gc_pending = false;                   // config waits for the GC numbered m_config_gc_seq
+static uint8_t m_config_gc_seq;
+static uint8_t m_gc_started;                               // fds_gc calls queued, FDS runs them in order
+static uint8_t m_gc_finished;                              // FDS_EVT_GC events seen
+static bool m_shutdown_pending = false;                    // shutdown waits for the config write
+APP_TIMER_DEF(m_config_timer_id);
+
+static fds_record_desc_t m_layer_desc;                     // calendar layer record, open while it is drawn
+static volatile fds_evt_id_t m_op_evt;                     // FDS event a layer or holiday save waits for
+static volatile uint16_t m_op_file_id;                     // file of the awaited write or delete
+static volatile bool m_op_busy = false;                    // save waits for m_op_evt
+static volatile ret_code_t m_op_result;                    // result of the awaited operation
+static uint8_t m_op_gc_seq;                                // number of the GC a save waits for
+APP_TIMER_DEF(m_op_timer_id);
+
 static void fds_evt_handler(fds_evt_t const * const p_fds_evt)
 {
     NRF_LOG_DEBUG("fds evt: id=%d result=%d\n", p_fds_evt->id, p_fds_evt->result);
+
+    switch (p_fds_evt->id)
+    {
+        case FDS_EVT_WRITE:
+        case FDS_EVT_UPDATE:
+            if (p_fds_evt->write.file_id != CONFIG_FILE_ID || p_fds_evt->write.record_key != CONFIG_REC_KEY)
+                break;
+            m_config_busy = false;
+            if (p_fds_evt->result == NRF_SUCCESS)
+                m_config_gc_done = false;
+            else
+                m_config_dirty = true;
+            epd_config_flush();
+            break;
+
+        case FDS_EVT_DEL_RECORD:
+            if (p_fds_evt->del.file_id != CONFIG_FILE_ID || p_fds_evt->del.record_key != CONFIG_REC_KEY)
+                break;
+            m_config_busy = false;
+            epd_config_flush();
+            break;
+
+        case FDS_EVT_GC:
+            // a GC started for a layer or holiday save does not end a config write
+            m_gc_finished++;
+            if (!m_config_gc_pending || m_gc_finished != m_config_gc_seq) break;
+            m_config_gc_pending = false;
+            m_config_busy = false;
+            epd_config_flush();
+            break;
+
+        default:
+            return;
+    }
+
+    if (m_shutdown_pending && !m_config_busy)
+        nrf_pwr_mgmt_shutdown(NRF_PWR_MGMT_SHUTDOWN_CONTINUE);
 }
 
-static void run_fds_gc(void * p_event_data, uint16_t event_size)
+static void op_fds_evt_handler(fds_evt_t const * const p_fds_evt)
+{
+    if (!m_op_busy || p_fds_evt->id != m_op_evt) return;
+
+    switch (p_fds_evt->id)
+    {
+        case FDS_EVT_WRITE:
+        case FDS_EVT_UPDATE:
+            if (p_fds_evt->write.file_id != m_op_file_id) return;
+            break;
+        case FDS_EVT_DEL_RECORD:
+            if (p_fds_evt->del.file_id != m_op_file_id) return;
+            break;
+        case FDS_EVT_GC:
+            // fds_evt_handler is registered first and has counted this GC already
+            if (m_gc_finished != m_op_gc_seq) return;
+            break;
+        default:
+            break;
+    }
+    m_op_result = p_fds_evt->result;
+    m_op_busy = false;
+}
+
+static void op_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    if (!m_op_busy) return;
+    m_op_result = NRF_ERROR_TIMEOUT;
+    m_op_busy = false;
+}
+
+static bool config_shutdown_handler(nrf_pwr_mgmt_evt_t event)
+{
+    m_shutdown_pending = true;
+    epd_config_flush();
+    return !m_config_busy;
+}
+
+#if defined(S112)
+NRF_PWR_MGMT_HANDLER_REGISTER(config_shutdown_handler, 0);
+#else
+NRF_PWR_MGMT_REGISTER_HANDLER(m_config_shutdown_handler) = config_shutdown_handler;
+#endif
+
+static void config_flush_handler(void * p_event_data, uint16_t event_size)
 {
+    epd_config_flush();
+}
+
+static void config_timeout_handler(void * p_context)
+{
+    app_sched_event_put(NULL, 0, config_flush_handler);
+}
+
+static void config_delete(void)
+{
+    ret_code_t          ret;
+    fds_record_desc_t   record_desc;
+    fds_find_token_t    ftok;
+
+    m_config_clear_pending = false;
+    memset(&ftok, 0x00, sizeof(fds_find_token_t));
+    if (fds_record_find(CONFIG_FILE_ID, CONFIG_REC_KEY, &record_desc, &ftok) != NRF_SUCCESS) {
+        NRF_LOG_DEBUG("epd_config_clear: record not found\n");
+        return;
+    }
+
+    ret = fds_record_delete(&record_desc);
+    if (ret == NRF_SUCCESS) {
+        m_config_busy = true;
+    } else {
+        NRF_LOG_ERROR("fds_record_delete failed, code=%d\n", ret);
+    }
+}
+
+static ret_code_t gc_start(void)
+{
+    ret_code_t ret;
+
     NRF_LOG_DEBUG("run garbage collection (fds_gc)\n");
-    fds_gc();
+    ret = fds_gc();
+    if (ret == NRF_SUCCESS)
+        m_gc_started++;
+    return ret;
+}
+
+static bool run_fds_gc(void)
+{
+    if (m_config_gc_done) return false;
+
+    m_config_gc_done = true;
+    if (gc_start() != NRF_SUCCESS) return false;
+    m_config_gc_seq = m_gc_started;
+    m_config_gc_pending = true;
+    m_config_busy = true;
+    return true;
 }
 
 void epd_config_init(epd_config_t *cfg)
 {
     ret_code_t ret;
 
+    m_config = cfg;
+    APP_ERROR_CHECK(app_timer_create(&m_config_timer_id, APP_TIMER_MODE_SINGLE_SHOT, config_timeout_handler));
+    APP_ERROR_CHECK(app_timer_create(&m_op_timer_id, APP_TIMER_MODE_SINGLE_SHOT, op_timeout_handler));
+
     ret = fds_register(fds_evt_handler);
     if (ret != NRF_SUCCESS) {
         NRF_LOG_ERROR("fds_register failed, code=%d\n", ret);
         return;
     }
 
+    ret = fds_register(op_fds_evt_handler);
+    if (ret != NRF_SUCCESS) {
+        NRF_LOG_ERROR("fds_register failed, code=%d\n", ret);
+        return;
+    }
+
     ret = fds_init();
     if (ret != NRF_SUCCESS) {
         NRF_LOG_ERROR("fds_init failed, code=%d\n", ret);
         return;
     }
-
-    run_fds_gc(NULL, 0);
 }
 
 void epd_config_read(epd_config_t *cfg)
@@ -60,26 +242,56 @@ void epd_config_read(epd_config_t *cfg)
 #else
     uint32_t record_len = flash_record.p_header->tl.length_words * sizeof(uint32_t);
 #endif
+    // older records end at week_start, the padding of their last word is not config
+    if (record_len < sizeof(epd_config_t))
+        record_len = MIN(record_len, offsetof(epd_config_t, adv_fast_interval));
     memcpy(cfg, flash_record.p_data, MIN(sizeof(epd_config_t), record_len));
     fds_record_close(&record_desc);
 }
 
 void epd_config_write(epd_config_t *cfg)
+{
+    m_config = cfg;
+    m_config_dirty = true;
+
+    // coalesce changes, the record is written once the config is quiet
+    app_timer_stop(m_config_timer_id);
+    app_timer_start(m_config_timer_id, CONFIG_WRITE_DELAY, NULL);
+}
+
+void epd_config_flush(void)
 {
     ret_code_t          ret;
     fds_record_t        record;
     fds_record_desc_t   record_desc;
     fds_find_token_t    ftok;
+    fds_stat_t          stat;
+
+    if (m_config_busy || m_config == NULL) return;
+    if (m_config_clear_pending) {
+        config_delete();
+        return;
+    }
+    if (!m_config_dirty) return;
+    app_timer_stop(m_config_timer_id);
+
+    // reclaim space only when it runs low
+    if (fds_stat(&stat) == NRF_SUCCESS && stat.largest_contig < CONFIG_MIN_FREE_WORDS &&
+        stat.freeable_words > 0 && run_fds_gc())
+        return;
+
+    memcpy(m_config_shadow, m_config, sizeof(epd_config_t));
+    m_config_dirty = false;
 
     record.file_id = CONFIG_FILE_ID;
     record.key = CONFIG_REC_KEY;
 #ifdef S112
-    record.data.p_data = (void*)cfg;
-    record.data.length_words = BYTES_TO_WORDS(sizeof(epd_config_t));
+    record.data.p_data = (void*)m_config_shadow;
+    record.data.length_words = CONFIG_REC_WORDS;
 #else
     fds_record_chunk_t record_chunk;
-    record_chunk.p_data = cfg;
-    record_chunk.length_words = BYTES_TO_WORDS(sizeof(epd_config_t));
+    record_chunk.p_data = m_config_shadow;
+    record_chunk.length_words = CONFIG_REC_WORDS;
     record.data.p_chunks = &record_chunk;
     record.data.num_chunks = 1;
 #endif
@@ -91,36 +303,291 @@ void epd_config_write(epd_config_t *cfg)
     else
         ret = fds_record_write(&record_desc, &record);
 
-    if (ret != NRF_SUCCESS) {
+    if (ret == NRF_SUCCESS) {
+        m_config_busy = true;
+    } else {
         NRF_LOG_ERROR("epd_config_save: record write/update failed, code=%d\n", ret);
+        m_config_dirty = true;
         if (ret == FDS_ERR_NO_SPACE_IN_FLASH)
-            app_sched_event_put(NULL, 0, run_fds_gc);
+            run_fds_gc();
     }
 }
 
+bool epd_config_busy(void)
+{
+    return m_config_busy;
+}
+
 void epd_config_clear(epd_config_t *cfg)
+{
+    // pending changes are dropped, an update in flight completes before the delete
+    m_config_dirty = false;
+    app_timer_stop(m_config_timer_id);
+    m_config_clear_pending = true;
+    epd_config_flush();
+}
+
+bool epd_config_empty(epd_config_t *cfg)
+{
+    for (uint8_t i = 0; i < EPD_CONFIG_SIZE; i++) {
+        if (((uint8_t *)cfg)[i] != 0xFF)
+            return false;
+    }
+    return true;
+}
+
+const uint16_t *epd_layer_load(uint16_t *words)
+{
+    fds_flash_record_t  flash_record;
+    fds_find_token_t    ftok;
+
+    memset(&ftok, 0x00, sizeof(fds_find_token_t));
+    if (fds_record_find(LAYER_FILE_ID, LAYER_REC_KEY, &m_layer_desc, &ftok) != NRF_SUCCESS)
+        return NULL;
+    // an open record is not moved by garbage collection
+    if (fds_record_open(&m_layer_desc, &flash_record) != NRF_SUCCESS) {
+        NRF_LOG_ERROR("epd_layer_load: record open failed!");
+        return NULL;
+    }
+#ifdef S112
+    *words = flash_record.p_header->length_words * 2;
+#else
+    *words = flash_record.p_header->tl.length_words * 2;
+#endif
+    return (const uint16_t *)flash_record.p_data;
+}
+
+void epd_layer_close(void)
+{
+    fds_record_close(&m_layer_desc);
+}
+
+// The layer and the holidays are saved from the scheduler. FDS reports back from
+// the SoftDevice event interrupt, which is not deferred to the scheduler, so the save
+// can sleep until then without deadlocking. It is never called from an interrupt. The
+// wait only holds back other scheduled events, and OP_TIMEOUT bounds it if the event
+// never comes.
+static void op_begin(fds_evt_id_t evt, uint16_t file_id)
+{
+    m_op_evt = evt;
+    m_op_file_id = file_id;
+    m_op_busy = true;
+}
+
+static ret_code_t op_wait(ret_code_t ret)
+{
+    if (ret != NRF_SUCCESS) {
+        m_op_busy = false;
+        return ret;
+    }
+    APP_ERROR_CHECK(app_timer_start(m_op_timer_id, OP_TIMEOUT, NULL));
+    while (m_op_busy)
+        nrf_pwr_mgmt_run();
+    app_timer_stop(m_op_timer_id);
+    if (m_op_result == NRF_ERROR_TIMEOUT)
+        NRF_LOG_ERROR("fds event %d timed out\n", m_op_evt);
+    return m_op_result;
+}
+
+// Collects garbage unless a record of length_words fits and still leaves room for the config.
+// No page is erased when even the deleted records would not free enough.
+static bool op_make_room(uint16_t length_words)
+{
+    fds_stat_t stat;
+    ret_code_t ret;
+
+    if (fds_stat(&stat) != NRF_SUCCESS) return false;
+    if (stat.largest_contig >= length_words + 3 + CONFIG_MIN_FREE_WORDS) return true;
+    if (stat.largest_contig + stat.freeable_words < length_words + 3 + CONFIG_MIN_FREE_WORDS) return false;
+
+    // the config may have a GC queued already, wait for the one started here
+    m_op_gc_seq = m_gc_started + 1;
+    op_begin(FDS_EVT_GC, 0);
+    ret = op_wait(gc_start());
+    return ret == NRF_SUCCESS && fds_stat(&stat) == NRF_SUCCESS &&
+           stat.largest_contig >= length_words + 3 + CONFIG_MIN_FREE_WORDS;
+}
+
+static ret_code_t op_delete(uint16_t file_id, fds_record_desc_t *p_desc)
+{
+    op_begin(FDS_EVT_DEL_RECORD, file_id);
+    return op_wait(fds_record_delete(p_desc));
+}
+
+void epd_layer_save(const uint16_t *data, uint16_t words)
 {
     ret_code_t          ret;
+    fds_record_t        record;
     fds_record_desc_t   record_desc;
     fds_find_token_t    ftok;
+    uint16_t            length_words = words / 2;
+
+    if (length_words > LAYER_MAX_WORDS) {
+        NRF_LOG_WARNING("epd_layer_save: %d words do not fit\n", length_words);
+        return;
+    }
 
+    // the page can not hold the old and the new layer, drop the old one first
     memset(&ftok, 0x00, sizeof(fds_find_token_t));
-    if (fds_record_find(CONFIG_FILE_ID, CONFIG_REC_KEY, &record_desc, &ftok) != NRF_SUCCESS) {
-        NRF_LOG_DEBUG("epd_config_clear: record not found\n");
+    if (fds_record_find(LAYER_FILE_ID, LAYER_REC_KEY, &record_desc, &ftok) == NRF_SUCCESS) {
+        ret = op_delete(LAYER_FILE_ID, &record_desc);
+        if (ret != NRF_SUCCESS) {
+            NRF_LOG_ERROR("epd_layer_save: record delete failed, code=%d\n", ret);
+            return;
+        }
+    }
+
+    // keep room for the config to be updated
+    if (!op_make_room(length_words)) {
+        NRF_LOG_WARNING("epd_layer_save: no space for %d words\n", length_words);
         return;
     }
 
-    ret = fds_record_delete(&record_desc);
+    record.file_id = LAYER_FILE_ID;
+    record.key = LAYER_REC_KEY;
+#ifdef S112
+    record.data.p_data = (void*)data;
+    record.data.length_words = length_words;
+#else
+    fds_record_chunk_t record_chunk;
+    record_chunk.p_data = data;
+    record_chunk.length_words = length_words;
+    record.data.p_chunks = &record_chunk;
+    record.data.num_chunks = 1;
+#endif
+
+    op_begin(FDS_EVT_WRITE, LAYER_FILE_ID);
+    ret = op_wait(fds_record_write(&record_desc, &record));
     if (ret != NRF_SUCCESS) {
-        NRF_LOG_ERROR("fds_record_delete failed, code=%d\n", ret);
+        NRF_LOG_ERROR("epd_layer_save: record write failed, code=%d\n", ret);
+        return;
     }
+    NRF_LOG_DEBUG("calendar layer saved, %d words\n", length_words);
 }
 
-bool epd_config_empty(epd_config_t *cfg)
+bool epd_holidays_get(uint16_t year, uint8_t month, uint32_t *off, uint32_t *work)
 {
-    for (uint8_t i = 0; i < EPD_CONFIG_SIZE; i++) {
-        if (((uint8_t *)cfg)[i] != 0xFF)
-            return false;
+    fds_flash_record_t  flash_record;
+    fds_record_desc_t   record_desc;
+    fds_find_token_t    ftok;
+    bool                found = false;
+
+    if (month < 1 || month > 12) return false;
+
+    memset(&ftok, 0x00, sizeof(fds_find_token_t));
+    if (fds_record_find(HOLIDAY_FILE_ID, year, &record_desc, &ftok) != NRF_SUCCESS)
+        return false;
+    if (fds_record_open(&record_desc, &flash_record) != NRF_SUCCESS) {
+        NRF_LOG_ERROR("epd_holidays_get: record open failed!");
+        return false;
     }
-    return true;
+#ifdef S112
+    uint16_t length_words = flash_record.p_header->length_words;
+#else
+    uint16_t length_words = flash_record.p_header->tl.length_words;
+#endif
+    const epd_holidays_t *holidays = (const epd_holidays_t *)flash_record.p_data;
+    if (length_words >= HOLIDAY_REC_WORDS && holidays->year == year) {
+        *off = holidays->off[month - 1];
+        *work = holidays->work[month - 1];
+        found = true;
+    }
+    fds_record_close(&record_desc);
+    return found;
+}
+
+// Finds the earliest saved year, returns the number of saved years.
+static uint8_t holidays_earliest(fds_record_desc_t *p_desc)
+{
+    fds_flash_record_t  flash_record;
+    fds_record_desc_t   record_desc;
+    fds_find_token_t    ftok;
+    uint16_t            earliest = 0xFFFF;
+    uint8_t             count = 0;
+
+    memset(&ftok, 0x00, sizeof(fds_find_token_t));
+    while (fds_record_find_in_file(HOLIDAY_FILE_ID, &record_desc, &ftok) == NRF_SUCCESS) {
+        if (fds_record_open(&record_desc, &flash_record) != NRF_SUCCESS) continue;
+        uint16_t year = ((const epd_holidays_t *)flash_record.p_data)->year;
+        fds_record_close(&record_desc);
+
+        count++;
+        if (year < earliest) {
+            earliest = year;
+            *p_desc = record_desc;
+        }
+    }
+    return count;
+}
+
+void epd_holidays_save(const epd_holidays_t *holidays)
+{
+    ret_code_t          ret;
+    fds_record_t        record;
+    fds_record_desc_t   record_desc;
+    fds_find_token_t    ftok;
+    bool                empty = true;
+
+    if (holidays->year == 0 || holidays->year > 0xBFFF) return; // not a valid record key
+
+    for (uint8_t i = 0; i < 12; i++) {
+        if (holidays->off[i] != 0 || holidays->work[i] != 0)
+            empty = false;
+    }
+
+    memset(&ftok, 0x00, sizeof(fds_find_token_t));
+    bool exists = fds_record_find(HOLIDAY_FILE_ID, holidays->year, &record_desc, &ftok) == NRF_SUCCESS;
+
+    // a year without any day removes it
+    if (empty) {
+        if (exists && (ret = op_delete(HOLIDAY_FILE_ID, &record_desc)) != NRF_SUCCESS)
+            NRF_LOG_ERROR("epd_holidays_save: record delete failed, code=%d\n", ret);
+        return;
+    }
+
+    if (!exists) {
+        fds_record_desc_t earliest_desc;
+        if (holidays_earliest(&earliest_desc) >= HOLIDAY_MAX_YEARS &&
+            (ret = op_delete(HOLIDAY_FILE_ID, &earliest_desc)) != NRF_SUCCESS) {
+            NRF_LOG_ERROR("epd_holidays_save: record delete failed, code=%d\n", ret);
+            return;
+        }
+    }
+
+    // the calendar layer is only a cache, it goes when the holidays do not fit next to it
+    if (!op_make_room(HOLIDAY_REC_WORDS)) {
+        fds_record_desc_t layer_desc;
+        memset(&ftok, 0x00, sizeof(fds_find_token_t));
+        if (fds_record_find(LAYER_FILE_ID, LAYER_REC_KEY, &layer_desc, &ftok) != NRF_SUCCESS ||
+            op_delete(LAYER_FILE_ID, &layer_desc) != NRF_SUCCESS || !op_make_room(HOLIDAY_REC_WORDS)) {
+            NRF_LOG_WARNING("epd_holidays_save: no space\n");
+            return;
+        }
+    }
+
+    record.file_id = HOLIDAY_FILE_ID;
+    record.key = holidays->year;
+#ifdef S112
+    record.data.p_data = (void*)holidays;
+    record.data.length_words = HOLIDAY_REC_WORDS;
+#else
+    fds_record_chunk_t record_chunk;
+    record_chunk.p_data = holidays;
+    record_chunk.length_words = HOLIDAY_REC_WORDS;
+    record.data.p_chunks = &record_chunk;
+    record.data.num_chunks = 1;
+#endif
+
+    if (exists) {
+        op_begin(FDS_EVT_UPDATE, HOLIDAY_FILE_ID);
+        ret = op_wait(fds_record_update(&record_desc, &record));
+    } else {
+        op_begin(FDS_EVT_WRITE, HOLIDAY_FILE_ID);
+        ret = op_wait(fds_record_write(&record_desc, &record));
+    }
+    if (ret != NRF_SUCCESS) {
+        NRF_LOG_ERROR("epd_holidays_save: record write failed, code=%d\n", ret);
+        return;
+    }
+    NRF_LOG_DEBUG("holidays of %d saved\n", holidays->year);
 }
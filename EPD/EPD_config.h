@@ -18,14 +18,37 @@ typedef struct
     uint8_t en_pin;
     uint8_t display_mode;
     uint8_t week_start;
+    uint8_t adv_fast_interval; // fast advertising interval (10 ms), 0 or 0xFF: 1 s
+    uint8_t adv_fast_timeout;  // fast advertising time (s), 0 or 0xFF: 120 s
+    uint8_t adv_slow_interval; // slow advertising interval (100 ms), 0 or 0xFF: 5 s
+    uint8_t adv_slow_timeout;  // slow advertising time (min), 0: none, 0xFF: 60 min
+    uint8_t adv_burst_period;  // time between advertising bursts (min), 0: none, 0xFF: 10 min
 } epd_config_t;
 
 #define EPD_CONFIG_SIZE (sizeof(epd_config_t) / sizeof(uint8_t))
+
+// Holidays and make-up working days of one year, bit d-1 of a mask stands for day d
+typedef struct
+{
+    uint16_t year;
+    uint16_t reserved;
+    uint32_t off[12];  // holidays, per month
+    uint32_t work[12]; // make-up working days, per month
+} epd_holidays_t;
     
 void epd_config_init(epd_config_t *cfg);
 void epd_config_read(epd_config_t *cfg);
 void epd_config_write(epd_config_t *cfg);
+void epd_config_flush(void);
+bool epd_config_busy(void);
 void epd_config_clear(epd_config_t *cfg);
 bool epd_config_empty(epd_config_t *cfg);
 
+const uint16_t *epd_layer_load(uint16_t *words);
+void epd_layer_close(void);
+void epd_layer_save(const uint16_t *data, uint16_t words);
+
+bool epd_holidays_get(uint16_t year, uint8_t month, uint32_t *off, uint32_t *work);
+void epd_holidays_save(const epd_holidays_t *holidays);
+
 #endif
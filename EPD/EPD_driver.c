@@ -15,6 +15,7 @@
 #include "app_error.h"
 #include "nrf_drv_spi.h"
 #include "EPD_driver.h"
+#include "EPD_energy.h"
 #include "nrf_log.h"
 
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
@@ -34,8 +35,19 @@ static uint32_t EPD_LED_PIN = 0xFF;
 // EPD model
 static epd_model_t *EPD = NULL;
 
+// VDD measured under load
+#define ADC_OVERSAMPLE        4   // conversions averaged on nRF51
+#define LOAD_SAMPLE_INTERVAL  20  // ms between samples while busy
+#define LOAD_AVG_SAMPLES      4   // samples averaged before taking the minimum
+static uint16_t m_load_mv = 0;
+static uint32_t m_load_sum = 0;
+static uint8_t m_load_count = 0;
+static void EPD_SampleLoadVoltage(void);
+
 #define SPI_INSTANCE  0 /**< SPI instance index. */
 static const nrf_drv_spi_t spi = NRF_DRV_SPI_INSTANCE(SPI_INSTANCE);  /**< SPI instance. */
+static uint32_t m_spi_bytes = 0; // transferred since the SPI time was last accounted
+static void EPD_SPI_Account(void);
 
 #if defined(S112)
 #define HAL_SPI_INSTANCE spi.u.spi.p_reg
@@ -130,6 +142,7 @@ void EPD_GPIO_Uninit(void)
 {
     if (--m_driver_refs > 0) return;
 
+    EPD_SPI_Account();
     EPD_LED_OFF();
 
     nrf_drv_spi_uninit(&spi);
@@ -153,6 +166,14 @@ void EPD_GPIO_Uninit(void)
 }
 
 // SPI
+// the SPI time goes to the energy counters once per transfer, not per command byte
+static void EPD_SPI_Account(void)
+{
+    if (m_spi_bytes == 0) return;
+    energy_add(ENERGY_SPI, ENERGY_SPI_US(m_spi_bytes));
+    m_spi_bytes = 0;
+}
+
 void EPD_SPI_Write(uint8_t *value, uint8_t len)
 {
     nrf_gpio_pin_dir_t dir = nrf_gpio_pin_dir_get(EPD_MOSI_PIN);
@@ -161,6 +182,7 @@ void EPD_SPI_Write(uint8_t *value, uint8_t len)
         nrf_spi_pins_set(HAL_SPI_INSTANCE, EPD_SCLK_PIN, EPD_MOSI_PIN, NRF_SPI_PIN_NOT_CONNECTED);
     }
     APP_ERROR_CHECK(nrf_drv_spi_transfer(&spi, value, len, NULL, 0));
+    m_spi_bytes += len;
 }
 
 void EPD_SPI_Read(uint8_t *value, uint8_t len)
@@ -171,6 +193,7 @@ void EPD_SPI_Read(uint8_t *value, uint8_t len)
         nrf_spi_pins_set(HAL_SPI_INSTANCE, EPD_SCLK_PIN, NRF_SPI_PIN_NOT_CONNECTED, EPD_MOSI_PIN);
     }
     APP_ERROR_CHECK(nrf_drv_spi_transfer(&spi, NULL, 0, value, len));
+    m_spi_bytes += len;
 }
 
 // EPD
@@ -234,11 +257,15 @@ void EPD_Reset(uint32_t value, uint16_t duration)
 void EPD_WaitBusy(uint32_t value, uint16_t timeout)
 {
     uint32_t led_status = digitalRead(EPD_LED_PIN);
+    uint32_t busy_ms = 0;
 
+    EPD_SPI_Account();
     NRF_LOG_DEBUG("[EPD]: check busy\n");
     while (digitalRead(EPD_BUSY_PIN) == value) {
         if (timeout % 100 == 0) EPD_LED_Toggle();
+        if (busy_ms % LOAD_SAMPLE_INTERVAL == 0) EPD_SampleLoadVoltage();
         delay(1);
+        busy_ms++;
         timeout--;
         if (timeout == 0) {
             NRF_LOG_DEBUG("[EPD]: busy timeout!\n");
@@ -246,6 +273,7 @@ void EPD_WaitBusy(uint32_t value, uint16_t timeout)
         }
     }
     NRF_LOG_DEBUG("[EPD]: busy release\n");
+    energy_add(ENERGY_EPD_BUSY, busy_ms * 1000);
 
     // restore led status
     if (led_status == LOW)
@@ -273,30 +301,35 @@ void EPD_LED_Toggle(void)
         nrf_gpio_pin_toggle(EPD_LED_PIN);
 }
 
-void EPD_LED_BLINK(void)
+// start a blink with on=true, end it with on=false, the caller keeps the time
+void EPD_LED_BLINK(bool on)
 {
     if (EPD_LED_PIN != 0xFF) {
-        pinMode(EPD_LED_PIN, OUTPUT);
-        digitalWrite(EPD_LED_PIN, LOW);
-        delay(100);
-        digitalWrite(EPD_LED_PIN, HIGH);
-        delay(100);
-        pinMode(EPD_LED_PIN, DEFAULT);
+        if (on) {
+            pinMode(EPD_LED_PIN, OUTPUT);
+            digitalWrite(EPD_LED_PIN, LOW);
+        } else {
+            digitalWrite(EPD_LED_PIN, HIGH);
+            pinMode(EPD_LED_PIN, DEFAULT);
+        }
     }
 }
 
-float EPD_ReadVoltage(void)
+// VDD in mV, averaged over several conversions
+static uint16_t EPD_ReadVDD(void)
 {
 #if defined(S112)
     volatile int16_t value = 0;
     NRF_SAADC->RESOLUTION = SAADC_RESOLUTION_VAL_10bit;
+    NRF_SAADC->OVERSAMPLE = SAADC_OVERSAMPLE_OVERSAMPLE_Over16x;
     NRF_SAADC->ENABLE = (SAADC_ENABLE_ENABLE_Enabled << SAADC_ENABLE_ENABLE_Pos);
     NRF_SAADC->CH[0].CONFIG = ((SAADC_CH_CONFIG_RESP_Bypass     << SAADC_CH_CONFIG_RESP_Pos)   & SAADC_CH_CONFIG_RESP_Msk)
                             | ((SAADC_CH_CONFIG_RESP_Bypass     << SAADC_CH_CONFIG_RESN_Pos)   & SAADC_CH_CONFIG_RESN_Msk)
                             | ((SAADC_CH_CONFIG_GAIN_Gain1_6    << SAADC_CH_CONFIG_GAIN_Pos)   & SAADC_CH_CONFIG_GAIN_Msk)
                             | ((SAADC_CH_CONFIG_REFSEL_Internal << SAADC_CH_CONFIG_REFSEL_Pos) & SAADC_CH_CONFIG_REFSEL_Msk)
                             | ((SAADC_CH_CONFIG_TACQ_3us        << SAADC_CH_CONFIG_TACQ_Pos)   & SAADC_CH_CONFIG_TACQ_Msk)
-                            | ((SAADC_CH_CONFIG_MODE_SE         << SAADC_CH_CONFIG_MODE_Pos)   & SAADC_CH_CONFIG_MODE_Msk);
+                            | ((SAADC_CH_CONFIG_MODE_SE         << SAADC_CH_CONFIG_MODE_Pos)   & SAADC_CH_CONFIG_MODE_Msk)
+                            | ((SAADC_CH_CONFIG_BURST_Enabled   << SAADC_CH_CONFIG_BURST_Pos)  & SAADC_CH_CONFIG_BURST_Msk);
     NRF_SAADC->CH[0].PSELN = SAADC_CH_PSELN_PSELN_NC;
     NRF_SAADC->CH[0].PSELP = SAADC_CH_PSELP_PSELP_VDD;
     NRF_SAADC->RESULT.PTR = (uint32_t)&value;
@@ -304,7 +337,7 @@ float EPD_ReadVoltage(void)
     NRF_SAADC->TASKS_START = 0x01UL;
     while (!NRF_SAADC->EVENTS_STARTED);
     NRF_SAADC->EVENTS_STARTED = 0x00UL;
-    NRF_SAADC->TASKS_SAMPLE = 0x01UL;
+    NRF_SAADC->TASKS_SAMPLE = 0x01UL; // burst mode takes all the oversampled conversions
     while (!NRF_SAADC->EVENTS_END);
     NRF_SAADC->EVENTS_END = 0x00UL;
     NRF_SAADC->TASKS_STOP = 0x01UL;
@@ -312,22 +345,59 @@ float EPD_ReadVoltage(void)
     NRF_SAADC->EVENTS_STOPPED = 0x00UL;
     if (value < 0) value = 0;
     NRF_SAADC->ENABLE = (SAADC_ENABLE_ENABLE_Disabled << SAADC_ENABLE_ENABLE_Pos);
+    NRF_SAADC->OVERSAMPLE = SAADC_OVERSAMPLE_OVERSAMPLE_Bypass;
 #else
+    uint16_t value = 0;
     NRF_ADC->ENABLE = 1;
     NRF_ADC->CONFIG = (ADC_CONFIG_RES_10bit << ADC_CONFIG_RES_Pos) |
                       (ADC_CONFIG_INPSEL_SupplyOneThirdPrescaling << ADC_CONFIG_INPSEL_Pos) |
                       (ADC_CONFIG_REFSEL_VBG << ADC_CONFIG_REFSEL_Pos) |
                       (ADC_CONFIG_PSEL_Disabled << ADC_CONFIG_PSEL_Pos) |
                       (ADC_CONFIG_EXTREFSEL_None << ADC_CONFIG_EXTREFSEL_Pos);
-    NRF_ADC->TASKS_START = 1;
-    while(!NRF_ADC->EVENTS_END);
-    NRF_ADC->EVENTS_END = 0;
-    uint16_t value = NRF_ADC->RESULT;
+    // no hardware oversampling on nRF51, average in software
+    for (uint8_t i = 0; i < ADC_OVERSAMPLE; i++) {
+        NRF_ADC->TASKS_START = 1;
+        while(!NRF_ADC->EVENTS_END);
+        NRF_ADC->EVENTS_END = 0;
+        value += NRF_ADC->RESULT;
+    }
+    value /= ADC_OVERSAMPLE;
     NRF_ADC->TASKS_STOP = 1;
     NRF_ADC->ENABLE = 0;
 #endif
-    NRF_LOG_DEBUG("ADC value: %d\n", value);
-    return (value * 3.6) / (1 << 10);
+    return (uint16_t)((value * 3600UL) >> 10);
+}
+
+float EPD_ReadVoltage(void)
+{
+    uint16_t mv = EPD_ReadVDD();
+    NRF_LOG_DEBUG("VDD: %d mV\n", mv);
+    return mv / 1000.0f;
+}
+
+void EPD_LoadVoltageReset(void)
+{
+    m_load_mv = 0;
+    m_load_sum = 0;
+    m_load_count = 0;
+}
+
+uint16_t EPD_LoadVoltage(void)
+{
+    return m_load_mv;
+}
+
+// sample VDD while the panel is busy, keep the lowest average of LOAD_AVG_SAMPLES
+static void EPD_SampleLoadVoltage(void)
+{
+    m_load_sum += EPD_ReadVDD();
+    if (++m_load_count < LOAD_AVG_SAMPLES) return;
+
+    uint16_t mv = m_load_sum / LOAD_AVG_SAMPLES;
+    if (m_load_mv == 0 || mv < m_load_mv)
+        m_load_mv = mv;
+    m_load_sum = 0;
+    m_load_count = 0;
 }
 
 // EPD models
@@ -108,10 +108,12 @@ void EPD_WaitBusy(uint32_t value, uint16_t timeout);
 void EPD_LED_ON(void);
 void EPD_LED_OFF(void);
 void EPD_LED_Toggle(void);
-void EPD_LED_BLINK(void);
+void EPD_LED_BLINK(bool on);
 
 // VDD voltage
 float EPD_ReadVoltage(void);
+void EPD_LoadVoltageReset(void);
+uint16_t EPD_LoadVoltage(void); // lowest VDD (mV) while busy since the reset, 0 if not sampled
 
 epd_model_t *epd_get(void);
 epd_model_t *epd_init(epd_model_id_t id);
@@ -0,0 +1,161 @@
+#include <stddef.h>
+#include <string.h>
+#include "EPD_energy.h"
+#ifdef SOFTDEVICE_PRESENT
+#include "app_util_platform.h"
+#endif
+
+// The counters are updated from the main loop, the SoftDevice event interrupt and the app_timer
+// interrupt. An update and its checksum must not be split, or the next boot drops all counters.
+#ifdef SOFTDEVICE_PRESENT
+#define ENERGY_LOCK()   CRITICAL_REGION_ENTER()
+#define ENERGY_UNLOCK() CRITICAL_REGION_EXIT()
+#else
+#define ENERGY_LOCK()   // the emulator has no interrupts
+#define ENERGY_UNLOCK()
+#endif
+
+#define ENERGY_MAGIC 0x454E5231 // "ENR1"
+
+static const uint32_t m_current_ua[ENERGY_SUBSYS_COUNT] = {
+    ENERGY_RADIO_CONN_UA,
+    ENERGY_RADIO_ADV_UA,
+    ENERGY_SPI_UA,
+    ENERGY_EPD_BUSY_UA,
+    ENERGY_CPU_UA,
+};
+
+static energy_counters_t *m_energy = NULL;          // counters, may live in retained RAM
+static uint64_t m_started_ms[ENERGY_SUBSYS_COUNT];  // start of the running periods
+static uint8_t m_running = 0;                       // bit mask of the running subsystems
+
+static uint32_t energy_check(energy_counters_t *counters)
+{
+    const uint32_t *p = (const uint32_t *)&counters->active_us[0];
+    uint32_t words = (sizeof(energy_counters_t) - offsetof(energy_counters_t, active_us)) / sizeof(uint32_t);
+    uint32_t sum = counters->magic;
+    while (words--) sum += *p++;
+    return ~sum;
+}
+
+static void energy_seal(void)
+{
+    m_energy->check = energy_check(m_energy);
+}
+
+// use the counters kept from before the reset when valid, clear them otherwise
+void energy_init(energy_counters_t *counters)
+{
+    m_energy = counters;
+    m_running = 0;
+    if (counters->magic != ENERGY_MAGIC || counters->check != energy_check(counters)) {
+        memset(counters, 0, sizeof(energy_counters_t));
+        counters->magic = ENERGY_MAGIC;
+        energy_seal();
+    }
+}
+
+void energy_add(energy_subsys_t subsys, uint32_t us)
+{
+    if (m_energy == NULL || us == 0) return;
+    ENERGY_LOCK();
+    m_energy->active_us[subsys] += us;
+    energy_seal();
+    ENERGY_UNLOCK();
+}
+
+void energy_start(energy_subsys_t subsys, uint64_t now_ms)
+{
+    ENERGY_LOCK();
+    if (!(m_running & (1 << subsys))) {
+        m_running |= 1 << subsys;
+        m_started_ms[subsys] = now_ms;
+    }
+    ENERGY_UNLOCK();
+}
+
+void energy_stop(energy_subsys_t subsys, uint64_t now_ms)
+{
+    if (m_energy == NULL) return;
+    ENERGY_LOCK();
+    if (m_running & (1 << subsys)) {
+        m_running &= ~(1 << subsys);
+        m_energy->active_us[subsys] += (now_ms - m_started_ms[subsys]) * 1000;
+        energy_seal();
+    }
+    ENERGY_UNLOCK();
+}
+
+// account the running periods so far, call it often enough to keep a period below 71 minutes
+void energy_checkpoint(uint64_t now_ms)
+{
+    if (m_energy == NULL) return;
+    ENERGY_LOCK();
+    if (m_running) {
+        for (uint8_t i = 0; i < ENERGY_SUBSYS_COUNT; i++) {
+            if (m_running & (1 << i)) {
+                m_energy->active_us[i] += (now_ms - m_started_ms[i]) * 1000;
+                m_started_ms[i] = now_ms;
+            }
+        }
+        energy_seal();
+    }
+    ENERGY_UNLOCK();
+}
+
+void energy_refresh(energy_refresh_t type)
+{
+    if (m_energy == NULL) return;
+    ENERGY_LOCK();
+    m_energy->refreshes[type]++;
+    energy_seal();
+    ENERGY_UNLOCK();
+}
+
+// the 64-bit counters are read in two halves, an interrupt must not update them in between
+static uint64_t energy_active_us(energy_subsys_t subsys)
+{
+    uint64_t us;
+    ENERGY_LOCK();
+    us = m_energy->active_us[subsys];
+    ENERGY_UNLOCK();
+    return us;
+}
+
+uint32_t energy_active_s(energy_subsys_t subsys)
+{
+    return m_energy ? (uint32_t)(energy_active_us(subsys) / 1000000) : 0;
+}
+
+uint32_t energy_charge_uah(energy_subsys_t subsys)
+{
+    if (m_energy == NULL) return 0;
+    return (uint32_t)(energy_active_us(subsys) / 1000 * m_current_ua[subsys] / 3600000);
+}
+
+uint32_t energy_refreshes(energy_refresh_t type)
+{
+    return m_energy ? m_energy->refreshes[type] : 0;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t value)
+{
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = (value >> 24) & 0xFF;
+    return p + 4;
+}
+
+// little endian, buf must hold ENERGY_DATA_LEN bytes
+uint16_t energy_encode(uint8_t *buf)
+{
+    uint8_t *p = buf;
+    for (uint8_t i = 0; i < ENERGY_SUBSYS_COUNT; i++) {
+        p = put_u32(p, energy_active_s((energy_subsys_t)i));
+        p = put_u32(p, energy_charge_uah((energy_subsys_t)i));
+    }
+    for (uint8_t i = 0; i < ENERGY_REFRESH_TYPES; i++)
+        p = put_u32(p, energy_refreshes((energy_refresh_t)i));
+    return (uint16_t)(p - buf);
+}
@@ -0,0 +1,71 @@
+#ifndef __EPD_ENERGY_H
+#define __EPD_ENERGY_H
+#include <stdbool.h>
+#include <stdint.h>
+
+// Average current of each subsystem while active (uA). Rough datasheet
+// figures, measure the board and override them for better estimates.
+#ifndef ENERGY_RADIO_CONN_UA
+#define ENERGY_RADIO_CONN_UA    60      // connected, default connection parameters
+#endif
+#ifndef ENERGY_RADIO_ADV_UA
+#define ENERGY_RADIO_ADV_UA     25      // advertising at 1 s interval
+#endif
+#ifndef ENERGY_SPI_UA
+#define ENERGY_SPI_UA           1500    // SPI master at 4 MHz, CPU waiting on it
+#endif
+#ifndef ENERGY_EPD_BUSY_UA
+#define ENERGY_EPD_BUSY_UA      5000    // panel refresh
+#endif
+#ifndef ENERGY_CPU_UA
+#if defined(S112)
+#define ENERGY_CPU_UA           2500    // nRF52811 running from flash
+#else
+#define ENERGY_CPU_UA           4000    // nRF51 running from flash
+#endif
+#endif
+
+#define ENERGY_SPI_US(bytes)    ((bytes) * 2)   // 8 bits at 4 MHz
+
+typedef enum
+{
+    ENERGY_RADIO_CONN = 0,
+    ENERGY_RADIO_ADV,
+    ENERGY_SPI,
+    ENERGY_EPD_BUSY,
+    ENERGY_CPU,
+    ENERGY_SUBSYS_COUNT,
+} energy_subsys_t;
+
+typedef enum
+{
+    ENERGY_REFRESH_CALENDAR = 0,
+    ENERGY_REFRESH_CLOCK,
+    ENERGY_REFRESH_PICTURE,
+    ENERGY_REFRESH_CLEAR,
+    ENERGY_REFRESH_TYPES,
+} energy_refresh_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t check;
+    uint64_t active_us[ENERGY_SUBSYS_COUNT];
+    uint32_t refreshes[ENERGY_REFRESH_TYPES];
+} energy_counters_t;
+
+// Size of the encoded counters: active seconds and charge (uAh) per subsystem, then the refresh counts.
+#define ENERGY_DATA_LEN (ENERGY_SUBSYS_COUNT * 8 + ENERGY_REFRESH_TYPES * 4)
+
+void energy_init(energy_counters_t *counters);
+void energy_add(energy_subsys_t subsys, uint32_t us);
+void energy_start(energy_subsys_t subsys, uint64_t now_ms);
+void energy_stop(energy_subsys_t subsys, uint64_t now_ms);
+void energy_checkpoint(uint64_t now_ms);
+void energy_refresh(energy_refresh_t type);
+uint32_t energy_active_s(energy_subsys_t subsys);
+uint32_t energy_charge_uah(energy_subsys_t subsys);
+uint32_t energy_refreshes(energy_refresh_t type);
+uint16_t energy_encode(uint8_t *buf);
+
+#endif
@@ -17,7 +17,9 @@
 #include "nrf_gpio.h"
 #include "nrf_pwr_mgmt.h"
 #include "app_scheduler.h"
+#include "crc16.h"
 #include "EPD_service.h"
+#include "EPD_energy.h"
 #include "main.h"
 #include "nrf_log.h"
 
@@ -32,11 +34,146 @@
 #define EPD_CFG_DEFAULT {0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x03, 0x09, 0x03}
 #endif
 
+static uint32_t m_xfer_start;  // RTC1 ticks when the current image transfer began
+static uint32_t m_xfer_bytes;  // bytes received in the current image transfer
+static uint16_t m_xfer_writes; // ATT writes received in the current image transfer
+static uint16_t m_xfer_crc;    // CRC16 of the image data received so far
+
+static epd_holidays_t m_holidays;         // holidays of a year received over BLE
+static uint8_t m_holidays_len;            // bytes of m_holidays received so far
+static volatile bool m_holidays_saving;   // m_holidays is being saved, further data is dropped
+
+#define BATTERY_LOAD_UA     (ENERGY_EPD_BUSY_UA + ENERGY_CPU_UA) // current drawn while the panel refreshes
+#define BATTERY_MIN_LOAD_MV 2200                                  // lowest VDD the refresh is expected to survive
+#define BATTERY_RETRY_S     120                                   // delay before an update skipped on a weak battery is retried
+
+// remaining capacity (%) of a 3 V primary cell against the VDD under refresh load
+static const uint16_t m_battery_curve[][2] = {
+    {2900, 100}, {2800, 80}, {2700, 60}, {2600, 40}, {2500, 20}, {2400, 10}, {BATTERY_MIN_LOAD_MV, 0},
+};
+
+static uint16_t m_battery_ohm;        // estimated internal resistance of the battery
+static bool m_battery_ohm_valid;      // set once a refresh has been measured
+static uint32_t m_retry_update;       // timestamp to retry an update skipped on a weak battery, 0 if none
+
+#define FRAME_SHOWN_MAGIC   0x46524D32                            // marks a valid retained frame signature ("FRM2")
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t signature;               // frame_signature() of the image on the panel
+    uint32_t check;
+} frame_shown_t;
+
+static buffer_callback m_write_image; // driver callback wrapped by epd_write_image
+static uint16_t m_frame_crc;          // CRC16 of the bands written so far
+static frame_shown_t m_frame_shown NOINIT; // kept across resets and system off, the panel keeps its image too
+
+// the calendar month layer is kept next to the config in FDS
+static const gui_layer_store_t m_layer_store = {epd_layer_load, epd_layer_close, epd_layer_save};
+
+// identity of a rendered frame: the CRC of the bands, then that CRC continued over the inputs
+static uint32_t frame_signature(ble_epd_t * p_epd, uint32_t timestamp)
+{
+    uint32_t period = p_epd->config.display_mode == MODE_CLOCK ? timestamp / 60 : timestamp / 86400;
+    uint8_t inputs[6] = {p_epd->config.model_id, p_epd->config.display_mode};
+    uint32_encode(period, &inputs[2]);
+    return ((uint32_t)m_frame_crc << 16) | crc16_compute(inputs, sizeof(inputs), &m_frame_crc);
+}
+
+// true when the panel already shows the frame with this signature
+static bool frame_is_shown(uint32_t signature)
+{
+    return m_frame_shown.magic == FRAME_SHOWN_MAGIC &&
+           m_frame_shown.check == ~(m_frame_shown.magic + m_frame_shown.signature) &&
+           m_frame_shown.signature == signature;
+}
+
+// record the frame on the panel, call with valid=false before the panel changes
+static void frame_set_shown(uint32_t signature, bool valid)
+{
+    m_frame_shown.magic = valid ? FRAME_SHOWN_MAGIC : 0;
+    m_frame_shown.signature = signature;
+    m_frame_shown.check = ~(m_frame_shown.magic + m_frame_shown.signature);
+}
+
+static void epd_write_image(uint8_t *black, uint8_t *color, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    uint32_t size = (w + 7) / 8 * h;
+    if (black == color) // 2 bits per pixel
+    {
+        m_frame_crc = crc16_compute(black, size * 2, &m_frame_crc);
+    }
+    else
+    {
+        if (black) m_frame_crc = crc16_compute(black, size, &m_frame_crc);
+        if (color) m_frame_crc = crc16_compute(color, size, &m_frame_crc);
+    }
+    m_write_image(black, color, x, y, w, h);
+}
+
+// VDD (mV) expected while the panel refreshes
+static uint16_t battery_load_mv(uint16_t idle_mv)
+{
+    uint32_t sag_mv = m_battery_ohm_valid ? (uint32_t)m_battery_ohm * BATTERY_LOAD_UA / 1000 : 0;
+    return idle_mv > sag_mv ? idle_mv - sag_mv : 0;
+}
+
+static uint8_t battery_level(uint16_t idle_mv)
+{
+    uint16_t mv = battery_load_mv(idle_mv);
+    if (mv >= m_battery_curve[0][0]) return 100;
+    for (uint8_t i = 1; i < ARRAY_SIZE(m_battery_curve); i++) {
+        if (mv >= m_battery_curve[i][0]) {
+            uint16_t v0 = m_battery_curve[i][0], v1 = m_battery_curve[i - 1][0];
+            uint16_t p0 = m_battery_curve[i][1], p1 = m_battery_curve[i - 1][1];
+            return p0 + (mv - v0) * (p1 - p0) / (v1 - v0);
+        }
+    }
+    return 0;
+}
+
+// update the internal resistance from the sag measured during the last refresh
+static void battery_update(uint16_t idle_mv)
+{
+    uint16_t load_mv = EPD_LoadVoltage();
+    if (load_mv == 0) return;
+
+    uint32_t ohm = load_mv < idle_mv ? (uint32_t)(idle_mv - load_mv) * 1000 / BATTERY_LOAD_UA : 0;
+    m_battery_ohm = m_battery_ohm_valid ? (3 * m_battery_ohm + ohm) / 4 : ohm;
+    m_battery_ohm_valid = true;
+    NRF_LOG_DEBUG("battery: idle %d mV, load %d mV, %d ohm\n", idle_mv, load_mv, m_battery_ohm);
+}
+
+// tell the client its update was dropped, it is retried after BATTERY_RETRY_S
+static void epd_send_skipped(ble_epd_t * p_epd, uint16_t idle_mv)
+{
+    char buf[20] = {0};
+    GFX_snprintf(buf, sizeof(buf), "skip=%u,%u", (unsigned int)idle_mv, (unsigned int)BATTERY_RETRY_S);
+    ble_epd_string_send(p_epd, (uint8_t *)buf, strlen(buf));
+}
+
 static void epd_gui_update(void * p_event_data, uint16_t event_size)
 {
     epd_gui_update_event_t *event = (epd_gui_update_event_t *)p_event_data;
     ble_epd_t *p_epd = event->p_epd;
 
+    // a brown-out mid refresh resets the chip and leaves the panel half drawn,
+    // skip the update and retry it shortly, forced updates included
+    float voltage = EPD_ReadVoltage();
+    uint16_t idle_mv = (uint16_t)(voltage * 1000);
+    if (battery_load_mv(idle_mv) < BATTERY_MIN_LOAD_MV && m_battery_ohm_valid) {
+        NRF_LOG_WARNING("battery too weak to refresh: %d mV, %d ohm\n", idle_mv, m_battery_ohm);
+        m_retry_update = timestamp() + BATTERY_RETRY_S;
+        // the clock timer is already armed for the old deadline, move it to the retry
+        clock_timer_restart();
+        p_epd->voltage = idle_mv;
+        advertising_update();
+        epd_send_skipped(p_epd, idle_mv);
+        return;
+    }
+    m_retry_update = 0;
+
     EPD_GPIO_Init();
     epd_model_t *epd = epd_init((epd_model_id_t)p_epd->config.model_id);
     gui_data_t data = {
@@ -46,8 +183,15 @@ static void epd_gui_update(void * p_event_data, uint16_t event_size)
         .timestamp       = event->timestamp,
         .week_start      = p_epd->config.week_start,
         .temperature     = epd->drv->read_temp(),
-        .voltage         = EPD_ReadVoltage(),
+        .voltage         = idle_mv,
+        .battery         = battery_level(idle_mv),
+        .layer_store     = &m_layer_store,
+        .holidays        = epd_holidays_get,
     };
+    data.arena = render_arena(&data.arena_size);
+    NRF_LOG_DEBUG("render arena: %d bytes\n", data.arena_size);
+    p_epd->temperature = data.temperature;
+    p_epd->voltage = idle_mv;
 
     char dev_name[20];
     uint16_t dev_name_len = sizeof(dev_name);
@@ -55,10 +199,32 @@ static void epd_gui_update(void * p_event_data, uint16_t event_size)
     if (err_code == NRF_SUCCESS && dev_name_len > 0)
         memcpy(data.ssid, dev_name, sizeof(data.ssid) - 1);
 
-    DrawGUI(&data, epd->drv->write_image, (display_mode_t)p_epd->config.display_mode);
-    epd->drv->refresh();
+    m_write_image = epd->drv->write_image;
+    m_frame_crc = 0xFFFF;
+    DrawGUI(&data, epd_write_image, (display_mode_t)p_epd->config.display_mode);
+
+    uint32_t glyph_hits, glyph_misses;
+    u8g2_GetGlyphCacheStats(&glyph_hits, &glyph_misses);
+    NRF_LOG_DEBUG("glyph cache: %d hits, %d misses\n", glyph_hits, glyph_misses);
+
+    // after a reset or wakeup the panel often shows this frame already, skip the waveform
+    uint32_t signature = frame_signature(p_epd, event->timestamp);
+    if (frame_is_shown(signature)) {
+        NRF_LOG_INFO("frame %x already shown, refresh skipped\n", signature);
+    } else {
+        frame_set_shown(signature, false);
+        EPD_LoadVoltageReset();
+        epd->drv->refresh();
+        frame_set_shown(signature, true);
+        battery_update(idle_mv);
+        energy_refresh(p_epd->config.display_mode == MODE_CLOCK ? ENERGY_REFRESH_CLOCK : ENERGY_REFRESH_CALENDAR);
+    }
     EPD_GPIO_Uninit();
 
+    p_epd->frame_crc = m_frame_crc;
+    advertising_update();
+    boot_phase_end(BOOT_PHASE_RENDER);
+
     app_feed_wdt();
 }
 
@@ -87,6 +253,27 @@ static void on_disconnect(ble_epd_t * p_epd, ble_evt_t * p_ble_evt)
     EPD_GPIO_Uninit();
 }
 
+#if !defined(S112)
+static void epd_sys_reset(void * p_event_data, uint16_t event_size)
+{
+    // wait for the pending config write or delete before resetting
+    epd_config_flush();
+    if (epd_config_busy())
+        app_sched_event_put(NULL, 0, epd_sys_reset);
+    else {
+        clock_prepare_reset();
+        NVIC_SystemReset();
+    }
+}
+#endif
+
+static void epd_holidays_save_handler(void * p_event_data, uint16_t event_size)
+{
+    epd_holidays_save(&m_holidays);
+    m_holidays_len = 0;
+    m_holidays_saving = false;
+}
+
 static void epd_update_display_mode(ble_epd_t * p_epd, display_mode_t mode)
 {
     if (p_epd->config.display_mode != mode) {
@@ -98,23 +285,58 @@ static void epd_update_display_mode(ble_epd_t * p_epd, display_mode_t mode)
 static void epd_send_time(ble_epd_t * p_epd)
 {
     char buf[20] = {0};
-    snprintf(buf, 20, "t=%"PRIu32, timestamp());
+    GFX_snprintf(buf, sizeof(buf), "t=%u", (unsigned int)timestamp());
     ble_epd_string_send(p_epd, (uint8_t *)buf, strlen(buf));
 }
 
 static void epd_send_mtu(ble_epd_t * p_epd)
 {
     char buf[10] = {0};
-    snprintf(buf, sizeof(buf), "mtu=%d", p_epd->max_data_len);
+    GFX_snprintf(buf, sizeof(buf), "mtu=%d", p_epd->max_data_len);
     ble_epd_string_send(p_epd, (uint8_t *)buf, strlen(buf));
 }
 
+static void epd_xfer_begin(void)
+{
+    m_xfer_start = app_timer_cnt_get();
+    m_xfer_bytes = 0;
+    m_xfer_writes = 0;
+    m_xfer_crc = 0xFFFF;
+}
+
+static void epd_xfer_log(void)
+{
+    if (m_xfer_writes == 0) return;
+
+    uint32_t ms = TIMER_MS(ticks_diff(app_timer_cnt_get(), m_xfer_start));
+    NRF_LOG_INFO("[EPD]: %d writes, %d bytes in %d ms\n", m_xfer_writes, m_xfer_bytes, ms);
+    m_xfer_writes = 0;
+}
+
 static void epd_service_on_write(ble_epd_t * p_epd, uint8_t * p_data, uint16_t length)
 {
     NRF_LOG_DEBUG("[EPD]: on_write LEN=%d\n", length);
     NRF_LOG_HEXDUMP_DEBUG(p_data, length);
     if (p_data == NULL || length <= 0) return;
 
+    switch (p_data[0])
+    {
+      case EPD_CMD_SEND_COMMAND:
+      case EPD_CMD_SEND_DATA:
+      case EPD_CMD_WRITE_IMAGE:
+          conn_params_on_transfer();
+          if (m_xfer_writes == 0) epd_xfer_begin();
+          m_xfer_writes++;
+          m_xfer_bytes += length;
+          m_xfer_crc = crc16_compute(p_data, length, &m_xfer_crc);
+          break;
+      case EPD_CMD_REFRESH:
+          epd_xfer_log();
+          break;
+      default:
+          break;
+    }
+
     switch (p_data[0])
     {
       case EPD_CMD_SET_PINS:
@@ -149,11 +371,17 @@ static void epd_service_on_write(ble_epd_t * p_epd, uint8_t * p_data, uint16_t l
 
       case EPD_CMD_CLEAR:
           epd_update_display_mode(p_epd, MODE_PICTURE);
+          frame_set_shown(0, false);
           p_epd->epd->drv->clear(length > 1 ? p_data[1] : true);
+          if (length < 2 || p_data[1]) energy_refresh(ENERGY_REFRESH_CLEAR);
+          p_epd->voltage = (uint16_t)(EPD_ReadVoltage() * 1000);
+          p_epd->frame_crc = 0;
+          advertising_update();
           break;
 
       case EPD_CMD_SEND_COMMAND:
           if (length < 2) return;
+          frame_set_shown(0, false); // may start a refresh
           EPD_WriteCmd(p_data[1]);
           break;
 
@@ -163,7 +391,14 @@ static void epd_service_on_write(ble_epd_t * p_epd, uint8_t * p_data, uint16_t l
 
       case EPD_CMD_REFRESH:
           epd_update_display_mode(p_epd, MODE_PICTURE);
+          frame_set_shown(0, false);
+          p_epd->voltage = (uint16_t)(EPD_ReadVoltage() * 1000); // idle VDD, before the load
+          EPD_LoadVoltageReset();
           p_epd->epd->drv->refresh();
+          energy_refresh(ENERGY_REFRESH_PICTURE);
+          battery_update(p_epd->voltage);
+          p_epd->frame_crc = m_xfer_crc;
+          advertising_update();
           break;
 
       case EPD_CMD_SLEEP:
@@ -178,8 +413,8 @@ static void epd_service_on_write(ble_epd_t * p_epd, uint8_t * p_data, uint16_t l
 
           uint32_t timestamp = (p_data[1] << 24) | (p_data[2] << 16) | (p_data[3] << 8) | p_data[4];
           timestamp += (length > 5 ? (int8_t)p_data[5] : 8) * 60 * 60; // timezone
-          set_timestamp(timestamp);
           epd_update_display_mode(p_epd, length > 6 ? (display_mode_t)p_data[6] : MODE_CALENDAR);
+          set_timestamp(timestamp);
           ble_epd_on_timer(p_epd, timestamp, true);
       } break;
 
@@ -191,8 +426,32 @@ static void epd_service_on_write(ble_epd_t * p_epd, uint8_t * p_data, uint16_t l
           }
           break;
 
+      case EPD_CMD_SET_HOLIDAYS: { // byte offset into epd_holidays_t, then the bytes from there on
+          if (length < 3 || m_holidays_saving) return;
+
+          uint8_t offset = p_data[1];
+          uint16_t size = length - 2;
+          if (offset == 0) m_holidays_len = 0;
+          if (offset != m_holidays_len || offset + size > sizeof(epd_holidays_t)) {
+              m_holidays_len = 0; // lost or bad chunk, wait for the year to be sent again
+              return;
+          }
+          memcpy((uint8_t *)&m_holidays + offset, &p_data[2], size);
+          m_holidays_len += size;
+
+          // flash is written from the scheduler, it waits there for FDS
+          if (m_holidays_len == sizeof(epd_holidays_t)) {
+              m_holidays_saving = true;
+              if (app_sched_event_put(NULL, 0, epd_holidays_save_handler) != NRF_SUCCESS) {
+                  m_holidays_len = 0;
+                  m_holidays_saving = false;
+              }
+          }
+      } break;
+
       case EPD_CMD_WRITE_IMAGE: // MSB=0000: ram begin, LSB=1111: black
           if (length < 3) return;
+          if (m_frame_shown.magic != 0) frame_set_shown(0, false); // first write of a new frame
           p_epd->epd->drv->write_ram((p_data[1] >> 4) == 0x00, (p_data[1] & 0x0F) == 0x0F, &p_data[2], length - 2);
           break;
 
@@ -210,14 +469,18 @@ static void epd_service_on_write(ble_epd_t * p_epd, uint8_t * p_data, uint16_t l
 #if defined(S112)
             nrf_pwr_mgmt_shutdown(NRF_PWR_MGMT_SHUTDOWN_RESET);
 #else
-            NVIC_SystemReset();
+            app_sched_event_put(NULL, 0, epd_sys_reset);
 #endif
         break;
 
       case EPD_CMD_CFG_ERASE:
           epd_config_clear(&p_epd->config);
-          nrf_delay_ms(100); // required
-          NVIC_SystemReset();
+          // reset once the delete has completed
+#if defined(S112)
+          nrf_pwr_mgmt_shutdown(NRF_PWR_MGMT_SHUTDOWN_RESET);
+#else
+          app_sched_event_put(NULL, 0, epd_sys_reset);
+#endif
           break;
 
       default:
@@ -265,6 +528,43 @@ static void on_write(ble_epd_t * p_epd, ble_evt_t * p_ble_evt)
     }
 }
 
+/**@brief Function for handling the @ref BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST event from the SoftDevice.
+ *
+ * @details The energy counters are read deferred, so they are up to date when read.
+ *
+ * @param[in] p_epd     EPD Service structure.
+ * @param[in] p_ble_evt Pointer to the event received from BLE stack.
+ */
+static void on_rw_authorize_request(ble_epd_t * p_epd, ble_evt_t * p_ble_evt)
+{
+    ble_gatts_evt_rw_authorize_request_t * p_req = &p_ble_evt->evt.gatts_evt.params.authorize_request;
+    ble_gatts_rw_authorize_reply_params_t reply;
+    uint8_t data[MAX(ENERGY_DATA_LEN, BOOT_DATA_LEN)];
+    uint16_t handle = p_req->request.read.handle;
+
+    if (p_req->type != BLE_GATTS_AUTHORIZE_TYPE_READ ||
+        (handle != p_epd->energy_handles.value_handle && handle != p_epd->boot_handles.value_handle))
+        return;
+
+    memset(&reply, 0, sizeof(reply));
+    reply.type = BLE_GATTS_AUTHORIZE_TYPE_READ;
+    reply.params.read.gatt_status = BLE_GATT_STATUS_SUCCESS;
+    // refresh the value on the first read, long reads continue from the stored value
+    if (p_req->request.read.offset == 0) {
+        if (handle == p_epd->boot_handles.value_handle) {
+            reply.params.read.len = boot_encode(data);
+        } else {
+            energy_checkpoint(uptime_ms());
+            reply.params.read.len = energy_encode(data);
+        }
+        reply.params.read.update = 1;
+        reply.params.read.p_data = data;
+    }
+    uint32_t err_code = sd_ble_gatts_rw_authorize_reply(p_epd->conn_handle, &reply);
+    if (err_code != NRF_SUCCESS)
+        NRF_LOG_ERROR("read reply failed, code=%d\n", err_code);
+}
+
 #if defined(S112)
 void ble_epd_evt_handler(ble_evt_t const * p_ble_evt, void * p_context)
 {
@@ -296,6 +596,10 @@ void ble_epd_on_ble_evt(ble_epd_t * p_epd, ble_evt_t * p_ble_evt)
             on_write(p_epd, p_ble_evt);
             break;
 
+        case BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST:
+            on_rw_authorize_request(p_epd, p_ble_evt);
+            break;
+
         default:
             // No implementation needed.
             break;
@@ -342,7 +646,29 @@ static uint32_t epd_service_init(ble_epd_t * p_epd)
     add_char_params.char_props.read          = 1;
     add_char_params.read_access              = SEC_OPEN;
 
-    return characteristic_add(p_epd->service_handle, &add_char_params, &p_epd->app_ver_handles);
+    VERIFY_SUCCESS(characteristic_add(p_epd->service_handle, &add_char_params, &p_epd->app_ver_handles));
+
+    memset(&add_char_params, 0, sizeof(add_char_params));
+    add_char_params.uuid                     = BLE_UUID_ENERGY;
+    add_char_params.uuid_type                = ble_uuid.type;
+    add_char_params.max_len                  = ENERGY_DATA_LEN;
+    add_char_params.init_len                 = ENERGY_DATA_LEN;
+    add_char_params.is_defered_read          = true;
+    add_char_params.char_props.read          = 1;
+    add_char_params.read_access              = SEC_OPEN;
+
+    VERIFY_SUCCESS(characteristic_add(p_epd->service_handle, &add_char_params, &p_epd->energy_handles));
+
+    memset(&add_char_params, 0, sizeof(add_char_params));
+    add_char_params.uuid                     = BLE_UUID_BOOT;
+    add_char_params.uuid_type                = ble_uuid.type;
+    add_char_params.max_len                  = BOOT_DATA_LEN;
+    add_char_params.init_len                 = BOOT_DATA_LEN;
+    add_char_params.is_defered_read          = true;
+    add_char_params.char_props.read          = 1;
+    add_char_params.read_access              = SEC_OPEN;
+
+    return characteristic_add(p_epd->service_handle, &add_char_params, &p_epd->boot_handles);
 }
 
 void ble_epd_sleep_prepare(ble_epd_t * p_epd)
@@ -383,9 +709,6 @@ uint32_t ble_epd_init(ble_epd_t * p_epd)
     // load config
     EPD_GPIO_Load(&p_epd->config);
 
-    // blink LED on start
-    EPD_LED_BLINK();
-
     // Add the service.
     return epd_service_init(p_epd);
 }
@@ -409,12 +732,37 @@ uint32_t ble_epd_string_send(ble_epd_t * p_epd, uint8_t * p_string, uint16_t len
     return sd_ble_gatts_hvx(p_epd->conn_handle, &hvx_params);
 }
 
+uint32_t ble_epd_next_update(ble_epd_t * p_epd, uint32_t timestamp)
+{
+    uint32_t seconds;
+
+    switch (p_epd->config.display_mode)
+    {
+        case MODE_CALENDAR:
+            seconds = 86400 - timestamp % 86400;
+            break;
+        case MODE_CLOCK:
+            seconds = 60 - timestamp % 60;
+            break;
+        default:
+            seconds = 0;
+            break;
+    }
+    // wake earlier for the retry of a skipped update
+    if (seconds != 0 && m_retry_update != 0) {
+        uint32_t retry = m_retry_update > timestamp ? m_retry_update - timestamp : 1;
+        seconds = MIN(seconds, retry);
+    }
+    p_epd->next_update = seconds ? timestamp + seconds : 0;
+    return seconds;
+}
+
 void ble_epd_on_timer(ble_epd_t * p_epd, uint32_t timestamp, bool force_update)
 {
-    // Update calendar on 00:00:00, clock on every minute
-    if (force_update || 
-        (p_epd->config.display_mode == MODE_CALENDAR && timestamp % 86400 == 0) ||
-        (p_epd->config.display_mode == MODE_CLOCK && timestamp % 60 == 0)) {
+    // Update calendar on 00:00:00, clock on every minute, or as soon as possible after a late wakeup
+    bool due = (p_epd->config.display_mode == MODE_CALENDAR || p_epd->config.display_mode == MODE_CLOCK) &&
+               p_epd->next_update != 0 && timestamp >= p_epd->next_update;
+    if (force_update || due) {
         epd_gui_update_event_t event = { p_epd, timestamp };
         app_sched_event_put(&event, sizeof(epd_gui_update_event_t), epd_gui_update);
     }
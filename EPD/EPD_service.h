@@ -50,6 +50,8 @@ void ble_epd_evt_handler(ble_evt_t const * p_ble_evt, void * p_context);
 #define BLE_UUID_EPD_SVC                   0x0001
 #define BLE_UUID_EPD_CHAR                  0x0002
 #define BLE_UUID_APP_VER                   0x0003
+#define BLE_UUID_ENERGY                    0x0004
+#define BLE_UUID_BOOT                      0x0005
 
 #define EPD_SVC_UUID_TYPE BLE_UUID_TYPE_VENDOR_BEGIN
 
@@ -72,6 +74,7 @@ enum EPD_CMDS
 
 	EPD_CMD_SET_TIME       = 0x20,                        /** < set time with unix timestamp */
     EPD_CMD_SET_WEEK_START = 0x21,                        /** < set week start day (0: Sunday, 1: Monday, ...) */
+    EPD_CMD_SET_HOLIDAYS   = 0x22,                        /** < set holidays of a year (epd_holidays_t), in chunks */
 
     EPD_CMD_WRITE_IMAGE    = 0x30,                        /** < write image data to EPD ram */
 
@@ -90,11 +93,17 @@ typedef struct
     uint16_t                 service_handle;          /**< Handle of EPD Service (as provided by the S110 SoftDevice). */
     ble_gatts_char_handles_t char_handles;            /**< Handles related to the EPD characteristic (as provided by the SoftDevice). */
     ble_gatts_char_handles_t app_ver_handles;         /**< Handles related to the APP version characteristic (as provided by the SoftDevice). */
+    ble_gatts_char_handles_t energy_handles;          /**< Handles related to the energy counters characteristic (as provided by the SoftDevice). */
+    ble_gatts_char_handles_t boot_handles;            /**< Handles related to the boot profile characteristic (as provided by the SoftDevice). */
     uint16_t                 conn_handle;             /**< Handle of the current connection (as provided by the SoftDevice). BLE_CONN_HANDLE_INVALID if not in a connection. */
     uint16_t                 max_data_len;            /**< Maximum length of data (in bytes) that can be transmitted to the peer */
     bool                     is_notification_enabled; /**< Variable to indicate if the peer has enabled notification of the RX characteristic.*/
     epd_model_t              *epd;                    /**< current EPD model */
     epd_config_t             config;                  /**< EPD config */
+    uint16_t                 voltage;                 /**< Last measured battery voltage (mV). */
+    int8_t                   temperature;             /**< Last EPD controller temperature. */
+    uint16_t                 frame_crc;               /**< CRC16 of the frame currently shown. */
+    uint32_t                 next_update;             /**< Timestamp of the next scheduled update, 0 if none. */
 } ble_epd_t;
 
 typedef struct
@@ -147,6 +156,17 @@ void ble_epd_on_ble_evt(ble_epd_t * p_epd, ble_evt_t * p_ble_evt);
  */
 uint32_t ble_epd_string_send(ble_epd_t * p_epd, uint8_t * p_string, uint16_t length);
 
+/**@brief Function for getting the time until the next scheduled display update.
+ *
+ * @param[in] p_epd       Pointer to the EPD Service structure.
+ * @param[in] timestamp   Current timestamp.
+ *
+ * @details The deadline is kept in @p p_epd and checked by @ref ble_epd_on_timer.
+ *
+ * @return Seconds until the next update, 0 if no update is scheduled in the current mode.
+ */
+uint32_t ble_epd_next_update(ble_epd_t * p_epd, uint32_t timestamp);
+
 void ble_epd_on_timer(ble_epd_t * p_epd, uint32_t timestamp, bool force_update);
 
 #endif // EPD_BLE_H__
@@ -33,8 +33,6 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <stdarg.h>
 #include <stddef.h>
-#include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 #include "Adafruit_GFX.h"
 
@@ -44,6 +42,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef MIN
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #endif
+#ifndef MAX
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#endif
 #ifndef SWAP
 #define SWAP(a, b, T) do { T t = a; a = b; b = t; } while (0)
 #endif
@@ -51,44 +52,138 @@ POSSIBILITY OF SUCH DAMAGE.
 #define CONTAINER_OF(ptr, type, member) (type *)((char *)ptr - offsetof(type, member))
 #endif
 
+// Display list entry: op | argc << 8, then argc words of arguments. The rows an
+// entry may touch are derived from its arguments when it is replayed.
+enum {
+  GFX_OP_PIXEL,              // color, x, y
+  GFX_OP_LINE,               // color, x0, y0, x1, y1
+  GFX_OP_HLINE,              // color, x, y, w
+  GFX_OP_VLINE,              // color, x, y, h
+  GFX_OP_FILL_RECT,          // color, x, y, w, h
+  GFX_OP_FILL_SCREEN,        // color
+  GFX_OP_CIRCLE,             // color, x0, y0, r
+  GFX_OP_CIRCLE_HELPER,      // color, x0, y0, r, cornername
+  GFX_OP_FILL_CIRCLE_HELPER, // color, x0, y0, r, corners, delta
+  GFX_OP_BITMAP,             // color, x, y, w, h, invert, bitmap
+  GFX_OP_FONT,               // font, applies to the following glyphs
+  GFX_OP_TEXT_COLOR,         // fg, bg, is_transparent | dir << 8
+  GFX_OP_GLYPHS,             // x, y, encodings
+  GFX_OP_BITMAP_BG,          // color, x, y, w, h, bg, bitmap
+};
+#define GFX_DL_PTR_WORDS ((sizeof(void *) + 1) / 2)
+
+static int16_t GFX_glyph(Adafruit_GFX *gfx, int16_t x, int16_t y, uint16_t e);
+
+static void GFX_setClip(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t x1, int16_t y1) {
+  gfx->clip_x0 = gfx->u8g2.clip_x0 = x0;
+  gfx->clip_y0 = gfx->u8g2.clip_y0 = y0;
+  gfx->clip_x1 = gfx->u8g2.clip_x1 = x1;
+  gfx->clip_y1 = gfx->u8g2.clip_y1 = y1;
+}
+
+// Rows of the current page mapped back through the window and the rotation, the
+// primitives and the glyph decoder clip against it before rasterizing. Unbounded
+// while recording.
+static void GFX_updateClip(Adafruit_GFX *gfx) {
+  if (gfx->dl_recording) {
+    GFX_setClip(gfx, INT16_MIN, INT16_MIN, INT16_MAX, INT16_MAX);
+    return;
+  }
+
+  int16_t xs = gfx->px, xe = gfx->px + gfx->pw - 1;
+  int16_t ys = gfx->py + gfx->current_page * gfx->page_height;
+  gfx->page_y = ys;
+  int16_t ye = MIN(ys + gfx->page_height, gfx->py + gfx->ph) - 1;
+  int16_t x0 = xs, y0 = ys, x1 = xe, y1 = ye;
+
+  switch (gfx->rotation) {
+    case GFX_ROTATE_0:
+      break;
+    case GFX_ROTATE_90:
+      x0 = ys; x1 = ye;
+      y0 = gfx->WIDTH - 1 - xe; y1 = gfx->WIDTH - 1 - xs;
+      break;
+    case GFX_ROTATE_180:
+      x0 = gfx->WIDTH - 1 - xe; x1 = gfx->WIDTH - 1 - xs;
+      y0 = gfx->HEIGHT - 1 - ye; y1 = gfx->HEIGHT - 1 - ys;
+      break;
+    case GFX_ROTATE_270:
+      x0 = gfx->HEIGHT - 1 - ye; x1 = gfx->HEIGHT - 1 - ys;
+      y0 = xs; y1 = xe;
+      break;
+  }
+
+  GFX_setClip(gfx, MAX(x0, 0), MAX(y0, 0), MIN(x1, gfx->_width - 1), MIN(y1, gfx->_height - 1));
+}
+
+// true if the box can not touch the current page
+static bool GFX_clipped(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t x1, int16_t y1) {
+  return x1 < gfx->clip_x0 || x0 > gfx->clip_x1 || y1 < gfx->clip_y0 || y0 > gfx->clip_y1;
+}
+
+static void GFX_fillArea(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+static void GFX_selectWriter(Adafruit_GFX *gfx);
+
+// A run of a decoded glyph, len > 0. Glyphs are recorded rather than decoded while
+// recording, so the run goes straight to the page buffer.
 static void GFX_u8g2_draw_hv_line(u8g2_font_t *u8g2, int16_t x, int16_t y,
                                   int16_t len, uint8_t dir, uint16_t color)
 {
   Adafruit_GFX *gfx = CONTAINER_OF(u8g2, Adafruit_GFX, u8g2);
   switch(dir) {
     case 0:
-      GFX_drawFastHLine(gfx, x, y, len, color);
+      GFX_fillArea(gfx, x, y, x + len - 1, y, color);
       break;
     case 1:
-      GFX_drawFastVLine(gfx, x, y, len, color);
+      GFX_fillArea(gfx, x, y, x, y + len - 1, color);
       break;
     case 2:
-      GFX_drawFastHLine(gfx, x - len + 1, y, len, color);
+      GFX_fillArea(gfx, x - len + 1, y, x, y, color);
       break;
     case 3:
-      GFX_drawFastVLine(gfx, x, y - len + 1, len, color);
+      GFX_fillArea(gfx, x, y - len + 1, x, y, color);
       break;
   }
 }
 
+// Pages as tall as the buffer allows, a row takes planes * (WIDTH + 7) / 8 bytes
+static bool GFX_setPages(Adafruit_GFX *gfx, uint8_t *buffer, uint32_t size, uint8_t planes) {
+  uint32_t rows = size / (((gfx->WIDTH + 7) / 8) * planes);
+  if (buffer == NULL || rows == 0 || gfx->HEIGHT <= 0) return false;
+  gfx->buffer = buffer;
+  gfx->page_height = MIN(rows, (uint32_t)gfx->HEIGHT);
+  gfx->total_pages = (gfx->HEIGHT / gfx->page_height) + (gfx->HEIGHT % gfx->page_height > 0);
+  // 3c: the color plane follows the black one, 4c moves it
+  gfx->color = planes > 1 ? buffer + ((gfx->WIDTH + 7) / 8) * gfx->page_height : NULL;
+  return true;
+}
+
+static bool GFX_beginPages(Adafruit_GFX *gfx, int16_t w, int16_t h, uint8_t *buffer, uint32_t size, uint8_t planes) {
+  memset(gfx, 0, sizeof(Adafruit_GFX));
+  memset(&gfx->u8g2, 0, sizeof(gfx->u8g2));
+  gfx->WIDTH = gfx->_width = w;
+  gfx->HEIGHT = gfx->_height = h;
+  gfx->u8g2.draw_hv_line = GFX_u8g2_draw_hv_line;
+
+  if (!GFX_setPages(gfx, buffer, size, planes)) return false;
+  GFX_setWindow(gfx, 0, 0, gfx->WIDTH, gfx->HEIGHT);
+  return true;
+}
+
 /**************************************************************************/
 /*!
    @brief    Instatiate a GFX context for graphics
    @param    w   Display width, in pixels
    @param    h   Display height, in pixels
-   @param    buffer_height Page buffer height
+   @param    buffer Page buffer, owned by the caller until GFX_end
+   @param    size   Page buffer size in bytes, the page height follows from it
+   @returns  false if the buffer can not hold a single row
 */
 /**************************************************************************/
-void GFX_begin(Adafruit_GFX *gfx, int16_t w, int16_t h, int16_t buffer_height) {
-  memset(gfx, 0, sizeof(Adafruit_GFX));
-  memset(&gfx->u8g2, 0, sizeof(gfx->u8g2));
-  gfx->WIDTH = gfx->_width = w;
-  gfx->HEIGHT = gfx->_height = h;
-  gfx->u8g2.draw_hv_line = GFX_u8g2_draw_hv_line;
-  gfx->buffer = malloc(((gfx->WIDTH + 7) / 8) * buffer_height);
-  gfx->page_height = buffer_height;
-  gfx->total_pages = (gfx->HEIGHT / gfx->page_height) + (gfx->HEIGHT % gfx->page_height > 0);
-  GFX_setWindow(gfx, 0, 0, gfx->WIDTH, gfx->HEIGHT);
+bool GFX_begin(Adafruit_GFX *gfx, int16_t w, int16_t h, uint8_t *buffer, uint32_t size) {
+  bool ok = GFX_beginPages(gfx, w, h, buffer, size, 1);
+  GFX_selectWriter(gfx);
+  return ok;
 }
 
 /**************************************************************************/
@@ -96,14 +191,15 @@ void GFX_begin(Adafruit_GFX *gfx, int16_t w, int16_t h, int16_t buffer_height) {
    @brief    Instatiate a 3-color GFX context for graphics
    @param    w   Display width, in pixels
    @param    h   Display height, in pixels
-   @param    buffer_height Page buffer height, should be multiple of 2
+   @param    buffer Page buffer, holds the black and the color plane
+   @param    size   Page buffer size in bytes
+   @returns  false if the buffer can not hold a single row
 */
 /**************************************************************************/
-void GFX_begin_3c(Adafruit_GFX *gfx, int16_t w, int16_t h, int16_t buffer_height) {
-  GFX_begin(gfx, w, h, buffer_height);
-  gfx->page_height /= 2;
-  gfx->color = gfx->buffer + ((gfx->WIDTH + 7) / 8) * gfx->page_height;
-  gfx->total_pages = (gfx->HEIGHT / gfx->page_height) + (gfx->HEIGHT % gfx->page_height > 0);
+bool GFX_begin_3c(Adafruit_GFX *gfx, int16_t w, int16_t h, uint8_t *buffer, uint32_t size) {
+  bool ok = GFX_beginPages(gfx, w, h, buffer, size, 2);
+  GFX_selectWriter(gfx);
+  return ok;
 }
 
 /**************************************************************************/
@@ -111,23 +207,135 @@ void GFX_begin_3c(Adafruit_GFX *gfx, int16_t w, int16_t h, int16_t buffer_height
    @brief    Instatiate a 4-color GFX context for graphics
    @param    w   Display width, in pixels
    @param    h   Display height, in pixels
-   @param    buffer_height Page buffer height, should be multiple of 2
+   @param    buffer Page buffer, 2 bits per pixel
+   @param    size   Page buffer size in bytes
+   @returns  false if the buffer can not hold a single row
 */
 /**************************************************************************/
-void GFX_begin_4c(Adafruit_GFX *gfx, int16_t w, int16_t h, int16_t buffer_height) {
-  GFX_begin(gfx, w, h, buffer_height);
-  gfx->page_height /= 2;
-  gfx->color = gfx->buffer;
-  gfx->total_pages = (gfx->HEIGHT / gfx->page_height) + (gfx->HEIGHT % gfx->page_height > 0);
+bool GFX_begin_4c(Adafruit_GFX *gfx, int16_t w, int16_t h, uint8_t *buffer, uint32_t size) {
+  bool ok = GFX_beginPages(gfx, w, h, buffer, size, 2);
+  if (ok) gfx->color = gfx->buffer;
+  GFX_selectWriter(gfx);
+  return ok;
 }
 
+// The page buffer and the display list belong to the caller, nothing is freed
 void GFX_end(Adafruit_GFX *gfx) {
-  if (gfx->buffer) free(gfx->buffer);
+  gfx->buffer = gfx->color = NULL;
+  gfx->dl = NULL;
+}
+
+/**************************************************************************/
+/*!
+   @brief    Start recording draw calls into a display list instead of drawing,
+   the list is then replayed on every page with GFX_replay
+   @param    list  Display list memory, owned by the caller
+   @param    size  Display list size in bytes
+   @returns  false if there is no room for a list, draw calls are not recorded then
+*/
+/**************************************************************************/
+bool GFX_beginRecord(Adafruit_GFX *gfx, uint16_t *list, uint16_t size) {
+  gfx->dl = size >= 2 ? list : NULL;
+  if (gfx->dl == NULL) return false;
+  gfx->dl_size = size / 2;
+  gfx->dl_len = 0;
+  gfx->dl_run = GFX_DL_NONE;
+  gfx->dl_font = GFX_DL_NONE;
+  gfx->dl_color = GFX_DL_NONE;
+  gfx->dl_overflow = false;
+  gfx->dl_recording = true;
+  GFX_updateClip(gfx);
+  return true;
+}
+
+/**************************************************************************/
+/*!
+   @brief    Stop recording
+   @returns  false if the draw calls did not fit, the list is dropped and the
+   caller has to draw every page itself
+*/
+/**************************************************************************/
+bool GFX_endRecord(Adafruit_GFX *gfx) {
+  gfx->dl_recording = false;
+  GFX_updateClip(gfx);
+  if (gfx->dl_overflow)
+    gfx->dl = NULL;
+  return gfx->dl != NULL;
+}
+
+/**************************************************************************/
+/*!
+   @brief    Take over the recorded display list, GFX_replay no longer uses it
+   @param    len  Set to the display list length in words
+   @returns  the display list (in the memory given to GFX_beginRecord), NULL if there is none
+*/
+/**************************************************************************/
+uint16_t *GFX_detachList(Adafruit_GFX *gfx, uint16_t *len) {
+  uint16_t *dl = gfx->dl;
+  *len = dl ? gfx->dl_len : 0;
+  gfx->dl = NULL;
+  return dl;
+}
+
+// append an entry, returns the index of its first argument or GFX_DL_NONE
+static uint16_t dl_record(Adafruit_GFX *gfx, uint8_t op, const int16_t *args, uint8_t argc) {
+  gfx->dl_run = GFX_DL_NONE;
+  if (gfx->dl_overflow || gfx->dl_len + 1 + argc > gfx->dl_size) {
+    gfx->dl_overflow = true;
+    return GFX_DL_NONE;
+  }
+  uint16_t *e = gfx->dl + gfx->dl_len;
+  e[0] = op | (argc << 8);
+  if (argc > 0) memcpy(&e[1], args, argc * sizeof(int16_t));
+  gfx->dl_len += 1 + argc;
+  return gfx->dl_len - argc;
+}
+
+static void dl_advance(uint8_t dir, int16_t *x, int16_t *y, int16_t delta) {
+  switch(dir) {
+    case 0: *x += delta; break;
+    case 1: *y += delta; break;
+    case 2: *x -= delta; break;
+    case 3: *y -= delta; break;
+  }
+}
+
+// glyphs drawn one after another share one entry, font and colors only when they change
+static void dl_record_glyph(Adafruit_GFX *gfx, int16_t x, int16_t y, uint16_t e, int16_t delta) {
+  u8g2_font_decode_t *decode = &gfx->u8g2.font_decode;
+  int16_t color[3] = {(int16_t)decode->fg_color, (int16_t)decode->bg_color,
+                      (int16_t)(decode->is_transparent | (decode->dir << 8))};
+
+  if (gfx->dl_font == GFX_DL_NONE ||
+      memcmp(&gfx->dl[gfx->dl_font], &gfx->u8g2.font, sizeof(gfx->u8g2.font)) != 0) {
+    int16_t args[GFX_DL_PTR_WORDS];
+    memcpy(args, &gfx->u8g2.font, sizeof(gfx->u8g2.font));
+    gfx->dl_font = dl_record(gfx, GFX_OP_FONT, args, GFX_DL_PTR_WORDS);
+  }
+  if (gfx->dl_color == GFX_DL_NONE || memcmp(&gfx->dl[gfx->dl_color], color, sizeof(color)) != 0)
+    gfx->dl_color = dl_record(gfx, GFX_OP_TEXT_COLOR, color, 3);
+
+  if (gfx->dl_run == GFX_DL_NONE || (gfx->dl[gfx->dl_run - 1] >> 8) == 0xFF ||
+      x != gfx->dl_run_x || y != gfx->dl_run_y) {
+    int16_t args[] = {x, y};
+    uint16_t run = dl_record(gfx, GFX_OP_GLYPHS, args, 2);
+    gfx->dl_run = run;
+  }
+  if (gfx->dl_overflow || gfx->dl_len + 1 > gfx->dl_size) {
+    gfx->dl_overflow = true;
+    return;
+  }
+  gfx->dl[gfx->dl_len++] = e;
+  gfx->dl[gfx->dl_run - 1] += 1 << 8;
+  gfx->dl_run_x = x;
+  gfx->dl_run_y = y;
+  dl_advance(decode->dir, &gfx->dl_run_x, &gfx->dl_run_y, delta);
 }
 
 void GFX_firstPage(Adafruit_GFX *gfx) {
   GFX_fillScreen(gfx, GFX_WHITE);
   gfx->current_page = 0;
+  GFX_updateClip(gfx);
 }
 
 bool GFX_nextPage(Adafruit_GFX *gfx, buffer_callback callback) {
@@ -146,6 +354,7 @@ bool GFX_nextPage(Adafruit_GFX *gfx, buffer_callback callback) {
   }
 
   gfx->current_page++;
+  GFX_updateClip(gfx);
   GFX_fillScreen(gfx, GFX_WHITE);
 
   return gfx->current_page < gfx->total_pages;
@@ -171,6 +380,8 @@ void GFX_setRotation(Adafruit_GFX *gfx, GFX_Rotate r) {
     gfx->_height = gfx->WIDTH;
     break;
   }
+  GFX_updateClip(gfx);
+  GFX_selectWriter(gfx);
 }
 
 /**************************************************************************/
@@ -211,12 +422,10 @@ void GFX_setWindow(Adafruit_GFX *gfx, uint16_t x, uint16_t y, uint16_t w, uint16
   gfx->pw += gfx->px % 8;
   if (gfx->pw % 8 > 0) gfx->pw += 8 - (gfx->pw % 8);
   gfx->px -= gfx->px % 8;
+  GFX_updateClip(gfx);
 }
 
 static uint8_t color4(uint16_t color) {
-  static uint16_t _prev_color = GFX_BLACK;
-  static uint8_t _prev_color4 = 0x00; // black
-  if (color == _prev_color) return _prev_color4;
   uint8_t cv4 = 0x00;
   switch (color)
   {
@@ -242,74 +451,189 @@ static uint8_t color4(uint16_t color) {
         else cv4 = 0x03; // blue
     } break;
   }
-  _prev_color = color;
-  _prev_color4 = cv4;
   return cv4;
 }
+
+enum { GFX_FORMAT_BW, GFX_FORMAT_3C, GFX_FORMAT_4C };
+
+static uint8_t GFX_format(Adafruit_GFX *gfx) {
+  if (gfx->color == gfx->buffer) return GFX_FORMAT_4C;
+  return gfx->color != NULL ? GFX_FORMAT_3C : GFX_FORMAT_BW;
+}
+
 /**************************************************************************/
 /*!
-   @brief    Draw a pixel
-    @param   x   x coordinate
-    @param   y   y coordinate
-   @param    color 16-bit 5-6-5 Color to fill with
+   @brief    Move the pages to another buffer, for instance to hand them the part of
+   the memory a display list did not take. Call it before GFX_firstPage.
+   @param    buffer Page buffer, same format as the one given to GFX_begin*
+   @param    size   Page buffer size in bytes, the page height follows from it
+   @returns  false if the buffer can not hold a single row, the old one is kept then
 */
 /**************************************************************************/
-void GFX_drawPixel(Adafruit_GFX *gfx, int16_t x, int16_t y, uint16_t color) {
-  if (x < 0 || x >= gfx->_width || y < 0 || y >= gfx->_height) return;
-  
+bool GFX_setBuffer(Adafruit_GFX *gfx, uint8_t *buffer, uint32_t size) {
+  uint8_t format = GFX_format(gfx);
+  if (!GFX_setPages(gfx, buffer, size, format == GFX_FORMAT_BW ? 1 : 2)) return false;
+  if (format == GFX_FORMAT_4C) gfx->color = gfx->buffer;
+  GFX_updateClip(gfx);
+  return true;
+}
+
+// Convert a color to the bytes written to the planes, pixels then only mask them in.
+// 3c: black clears the buffer bit, other colors than black and white the color bit.
+static void GFX_makePen(Adafruit_GFX *gfx, uint16_t color) {
+  gfx->pen_color = color;
+  switch (GFX_format(gfx)) {
+    case GFX_FORMAT_4C:
+      gfx->pen[0] = gfx->pen[1] = color4(color) * 0x55; // 0b01010101
+      break;
+    case GFX_FORMAT_3C:
+      gfx->pen[0] = color == GFX_BLACK ? 0x00 : 0xFF;
+      gfx->pen[1] = (color == GFX_BLACK || color == GFX_WHITE) ? 0xFF : 0x00;
+      break;
+    default:
+      gfx->pen[0] = color == GFX_WHITE ? 0xFF : 0x00;
+      gfx->pen[1] = 0xFF;
+      break;
+  }
+}
+
+static inline void GFX_setPen(Adafruit_GFX *gfx, uint16_t color) {
+  if (color != gfx->pen_color) GFX_makePen(gfx, color);
+}
+
+static inline void GFX_plot1(uint8_t *plane, uint16_t stride, uint16_t x, uint16_t y, uint8_t pen) {
+  uint8_t *p = plane + x / 8 + (uint32_t)y * stride;
+  uint8_t mask = 0x80 >> (x & 7);
+  *p = (*p & ~mask) | (pen & mask);
+}
+
+static inline void GFX_plot2(uint8_t *plane, uint16_t stride, uint16_t x, uint16_t y, uint8_t pen) {
+  uint8_t *p = plane + x / 4 + (uint32_t)y * stride;
+  uint8_t mask = 0xC0 >> ((x & 3) * 2);
+  *p = (*p & ~mask) | (pen & mask);
+}
+
+// page buffer coordinates of a display pixel, per rotation
+#define GFX_PAGE_XY_0   bx = x;                  by = y;
+#define GFX_PAGE_XY_90  bx = gfx->WIDTH - 1 - y; by = x;
+#define GFX_PAGE_XY_180 bx = gfx->WIDTH - 1 - x; by = gfx->HEIGHT - 1 - y;
+#define GFX_PAGE_XY_270 bx = y;                  by = gfx->HEIGHT - 1 - x;
+
+#define GFX_PLOT_BW GFX_plot1(gfx->buffer, gfx->pw / 8, bx, by, gfx->pen[0]);
+#define GFX_PLOT_3C GFX_plot1(gfx->buffer, gfx->pw / 8, bx, by, gfx->pen[0]); \
+                    GFX_plot1(gfx->color, gfx->pw / 8, bx, by, gfx->pen[1]);
+#define GFX_PLOT_4C GFX_plot2(gfx->buffer, gfx->pw / 4, bx, by, gfx->pen[0]);
+
+#define GFX_PIXEL_WRITER(fmt, rot)                                                  \
+  static void GFX_writePixel_##fmt##_##rot(Adafruit_GFX *gfx, int16_t x, int16_t y) { \
+    uint16_t bx, by;                                                                \
+    GFX_PAGE_XY_##rot                                                               \
+    bx -= gfx->px;                                                                  \
+    by -= gfx->page_y;                                                              \
+    GFX_PLOT_##fmt                                                                  \
+  }
+
+#define GFX_PIXEL_WRITERS(fmt) \
+  GFX_PIXEL_WRITER(fmt, 0) GFX_PIXEL_WRITER(fmt, 90) GFX_PIXEL_WRITER(fmt, 180) GFX_PIXEL_WRITER(fmt, 270)
+
+GFX_PIXEL_WRITERS(BW)
+GFX_PIXEL_WRITERS(3C)
+GFX_PIXEL_WRITERS(4C)
+
+static const gfx_pixel_writer GFX_pixel_writers[3][4] = {
+  [GFX_FORMAT_BW] = {GFX_writePixel_BW_0, GFX_writePixel_BW_90, GFX_writePixel_BW_180, GFX_writePixel_BW_270},
+  [GFX_FORMAT_3C] = {GFX_writePixel_3C_0, GFX_writePixel_3C_90, GFX_writePixel_3C_180, GFX_writePixel_3C_270},
+  [GFX_FORMAT_4C] = {GFX_writePixel_4C_0, GFX_writePixel_4C_90, GFX_writePixel_4C_180, GFX_writePixel_4C_270},
+};
+
+// Called whenever the buffer format or the rotation changes
+static void GFX_selectWriter(Adafruit_GFX *gfx) {
+  gfx->write_pixel = GFX_pixel_writers[GFX_format(gfx)][gfx->rotation & 3];
+  GFX_makePen(gfx, gfx->pen_color);
+}
+// Fill x0..x1 of rows y0..y1 in a page buffer plane with 1 or 2 bits per pixel,
+// pattern holds the pixel value repeated over the byte.
+static void GFX_fillPlane(uint8_t *plane, uint16_t stride, uint8_t bpp, int16_t x0, int16_t y0,
+                          int16_t x1, int16_t y1, uint8_t pattern) {
+  uint8_t ppb = 8 / bpp; // pixels per byte
+  uint16_t b0 = x0 / ppb, b1 = x1 / ppb;
+  uint8_t lmask = 0xFF >> ((x0 % ppb) * bpp);
+  uint8_t rmask = 0xFF << ((ppb - 1 - x1 % ppb) * bpp);
+  if (b0 == b1) lmask &= rmask;
+
+  for (uint8_t *row = plane + (uint32_t)y0 * stride; y0 <= y1; y0++, row += stride) {
+    row[b0] = (row[b0] & ~lmask) | (pattern & lmask);
+    if (b1 > b0) {
+      memset(&row[b0 + 1], pattern, b1 - b0 - 1);
+      row[b1] = (row[b1] & ~rmask) | (pattern & rmask);
+    }
+  }
+}
+
+// Fill a box with the same result as GFX_drawPixel() on each of its pixels,
+// coordinates are rotated and inclusive, the box is clipped to the current page.
+static void GFX_fillArea(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+  x0 = MAX(x0, gfx->clip_x0);
+  y0 = MAX(y0, gfx->clip_y0);
+  x1 = MIN(x1, gfx->clip_x1);
+  y1 = MIN(y1, gfx->clip_y1);
+  if (x0 > x1 || y0 > y1) return;
+
+  int16_t t;
   switch (gfx->rotation) {
     case GFX_ROTATE_0:
       break;
     case GFX_ROTATE_90:
-      SWAP(x, y, int16_t);
-      x = gfx->WIDTH - x - 1;
+      t = x0; x0 = gfx->WIDTH - 1 - y1; y1 = x1;
+      x1 = gfx->WIDTH - 1 - y0; y0 = t;
       break;
     case GFX_ROTATE_180:
-      x = gfx->WIDTH - x - 1;
-      y = gfx->HEIGHT - y - 1;
+      t = x0; x0 = gfx->WIDTH - 1 - x1; x1 = gfx->WIDTH - 1 - t;
+      t = y0; y0 = gfx->HEIGHT - 1 - y1; y1 = gfx->HEIGHT - 1 - t;
       break;
     case GFX_ROTATE_270:
-      SWAP(x, y, int16_t);
-      y = gfx->HEIGHT - y - 1;
+      t = x0; x0 = y0; y0 = gfx->HEIGHT - 1 - x1;
+      x1 = y1; y1 = gfx->HEIGHT - 1 - t;
       break;
   }
 
-  // transpose partial window to 0,0
-  x -= gfx->px;
-  y -= gfx->py;
-  // clip to (partial) window
-  if (x < 0 || x >= gfx->pw || y < 0 || y >= gfx->ph) return;
-  // adjust for current page
-  y -= gfx->current_page * gfx->page_height;
-  // check if in current page
-  if (y < 0 || y >= gfx->page_height) return;
+  // page buffer coordinates
+  x0 -= gfx->px;
+  x1 -= gfx->px;
+  y0 -= gfx->page_y;
+  y1 -= gfx->page_y;
 
+  GFX_setPen(gfx, color);
   if (gfx->color == gfx->buffer) { // 4c
-    uint32_t i = x / 4 + ((uint32_t)y) * (gfx->pw / 4);
-    uint8_t pv = color4(color);
-    switch(x % 4) {
-      case 0: gfx->buffer[i] = (gfx->buffer[i] & 0x3F) | (pv << 6); break;
-      case 1: gfx->buffer[i] = (gfx->buffer[i] & 0xCF) | (pv << 4); break;
-      case 2: gfx->buffer[i] = (gfx->buffer[i] & 0xF3) | (pv << 2); break;
-      case 3: gfx->buffer[i] = (gfx->buffer[i] & 0xFC) | pv; break;
-    }
-  } else if (gfx->color != NULL) { // 3c
-    uint16_t i = x / 8 + y * (gfx->pw / 8);
-    gfx->buffer[i] |= 0x80 >> (x & 7); // white
-    gfx->color[i] |= 0x80 >> (x & 7);
-    if (color == GFX_BLACK)
-      gfx->buffer[i] &= ~(0x80 >> (x & 7));
-    else if (color != GFX_WHITE)
-      gfx->color[i] &= ~(0x80 >> (x & 7));
+    GFX_fillPlane(gfx->buffer, gfx->pw / 4, 2, x0, y0, x1, y1, gfx->pen[0]);
   } else {
-    uint16_t i = x / 8 + y * (gfx->pw / 8);
-    if (color == GFX_WHITE)
-      gfx->buffer[i] |= 0x80 >> (x & 7);
-    else
-      gfx->buffer[i] &= ~(0x80 >> (x & 7));
+    GFX_fillPlane(gfx->buffer, gfx->pw / 8, 1, x0, y0, x1, y1, gfx->pen[0]);
+    if (gfx->color != NULL) // 3c
+      GFX_fillPlane(gfx->color, gfx->pw / 8, 1, x0, y0, x1, y1, gfx->pen[1]);
   }
 }
 
+/**************************************************************************/
+/*!
+   @brief    Draw a pixel
+    @param   x   x coordinate
+    @param   y   y coordinate
+   @param    color 16-bit 5-6-5 Color to fill with
+*/
+/**************************************************************************/
+void GFX_drawPixel(Adafruit_GFX *gfx, int16_t x, int16_t y, uint16_t color) {
+  if (gfx->dl_recording) {
+    int16_t args[] = {(int16_t)color, x, y};
+    dl_record(gfx, GFX_OP_PIXEL, args, 3);
+    return;
+  }
+  // the clip box is the display, the window and the current page in one
+  if (x < gfx->clip_x0 || x > gfx->clip_x1 || y < gfx->clip_y0 || y > gfx->clip_y1) return;
+
+  GFX_setPen(gfx, color);
+  gfx->write_pixel(gfx, x, y);
+}
+
 /**************************************************************************/
 /*!
    @brief    Draw a line.  Bresenham's algorithm - thx wikpedia
@@ -322,6 +646,21 @@ void GFX_drawPixel(Adafruit_GFX *gfx, int16_t x, int16_t y, uint16_t color) {
 /**************************************************************************/
 void GFX_drawLine(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t x1, int16_t y1,
                    uint16_t color) {
+  if (gfx->dl_recording) {
+    int16_t args[] = {(int16_t)color, x0, y0, x1, y1};
+    dl_record(gfx, GFX_OP_LINE, args, 5);
+    return;
+  }
+  if (y0 == y1) {
+    GFX_fillArea(gfx, MIN(x0, x1), y0, MAX(x0, x1), y0, color);
+    return;
+  }
+  if (x0 == x1) {
+    GFX_fillArea(gfx, x0, MIN(y0, y1), x0, MAX(y0, y1), color);
+    return;
+  }
+  if (GFX_clipped(gfx, MIN(x0, x1), MIN(y0, y1), MAX(x0, x1), MAX(y0, y1))) return;
+
   int16_t steep = ABS(y1 - y0) > ABS(x1 - x0);
   if (steep) {
     SWAP(x0, y0, int16_t);
@@ -346,7 +685,9 @@ void GFX_drawLine(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t x1, int16_t
     ystep = -1;
   }
 
-  for (; x0 <= x1; x0++) {
+  // x0 walks along the major axis, stop once it leaves the page
+  int16_t last = steep ? gfx->clip_y1 : gfx->clip_x1;
+  for (; x0 <= x1 && x0 <= last; x0++) {
     if (steep) {
       GFX_drawPixel(gfx, y0, x0, color);
     } else {
@@ -371,7 +712,13 @@ void GFX_drawLine(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t x1, int16_t
 /**************************************************************************/
 void GFX_drawFastVLine(Adafruit_GFX *gfx, int16_t x, int16_t y, int16_t h,
                        uint16_t color) {
-  GFX_drawLine(gfx, x, y, x, y + h - 1, color);
+  if (gfx->dl_recording) {
+    int16_t args[] = {(int16_t)color, x, y, h};
+    dl_record(gfx, GFX_OP_VLINE, args, 4);
+    return;
+  }
+  // same pixels as GFX_drawLine(), which draws h <= 0 upwards
+  GFX_fillArea(gfx, x, MIN(y, y + h - 1), x, MAX(y, y + h - 1), color);
 }
 
 /**************************************************************************/
@@ -385,7 +732,12 @@ void GFX_drawFastVLine(Adafruit_GFX *gfx, int16_t x, int16_t y, int16_t h,
 /**************************************************************************/
 void GFX_drawFastHLine(Adafruit_GFX *gfx, int16_t x, int16_t y, int16_t w,
                        uint16_t color) {
-  GFX_drawLine(gfx, x, y, x + w - 1, y, color);
+  if (gfx->dl_recording) {
+    int16_t args[] = {(int16_t)color, x, y, w};
+    dl_record(gfx, GFX_OP_HLINE, args, 4);
+    return;
+  }
+  GFX_fillArea(gfx, MIN(x, x + w - 1), y, MAX(x, x + w - 1), y, color);
 }
 
 /**************************************************************************/
@@ -400,9 +752,14 @@ void GFX_drawFastHLine(Adafruit_GFX *gfx, int16_t x, int16_t y, int16_t w,
 /**************************************************************************/
 void GFX_fillRect(Adafruit_GFX *gfx, int16_t x, int16_t y, int16_t w, int16_t h,
                   uint16_t color) {
-  for (int16_t i = x; i < x + w; i++) {
-    GFX_drawFastVLine(gfx, i, y, h, color);
+  if (gfx->dl_recording) {
+    int16_t args[] = {(int16_t)color, x, y, w, h};
+    dl_record(gfx, GFX_OP_FILL_RECT, args, 5);
+    return;
   }
+  if (w <= 0) return;
+  // every column is a GFX_drawFastVLine(), so h <= 0 fills upwards
+  GFX_fillArea(gfx, x, MIN(y, y + h - 1), x + w - 1, MAX(y, y + h - 1), color);
 }
 
 /**************************************************************************/
@@ -412,10 +769,15 @@ void GFX_fillRect(Adafruit_GFX *gfx, int16_t x, int16_t y, int16_t w, int16_t h,
 */
 /**************************************************************************/
 void GFX_fillScreen(Adafruit_GFX *gfx, uint16_t color) {
+  if (gfx->dl_recording) {
+    int16_t args[] = {(int16_t)color};
+    dl_record(gfx, GFX_OP_FILL_SCREEN, args, 1);
+    return;
+  }
   uint32_t size = ((gfx->WIDTH + 7) / 8) * gfx->page_height;
   if (gfx->color == gfx->buffer) { // 4c
-    uint8_t pv = color4(color) * 0x55; // 0b01010101
-    memset(gfx->buffer, pv, size * 2);
+    GFX_setPen(gfx, color);
+    memset(gfx->buffer, gfx->pen[0], size * 2);
   } else {
     memset(gfx->buffer, color == GFX_WHITE ? 0xFF : 0x00, size);
     if (gfx->color != NULL)
@@ -434,6 +796,13 @@ void GFX_fillScreen(Adafruit_GFX *gfx, uint16_t color) {
 /**************************************************************************/
 void GFX_drawCircle(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t r,
                     uint16_t color) {
+  if (gfx->dl_recording) {
+    int16_t args[] = {(int16_t)color, x0, y0, r};
+    dl_record(gfx, GFX_OP_CIRCLE, args, 4);
+    return;
+  }
+  if (GFX_clipped(gfx, x0 - ABS(r), y0 - ABS(r), x0 + ABS(r), y0 + ABS(r))) return;
+
   int16_t f = 1 - r;
   int16_t ddF_x = 1;
   int16_t ddF_y = -2 * r;
@@ -479,6 +848,13 @@ void GFX_drawCircle(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t r,
 /**************************************************************************/
 void GFX_drawCircleHelper(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t r,
                           uint8_t cornername, uint16_t color) {
+  if (gfx->dl_recording) {
+    int16_t args[] = {(int16_t)color, x0, y0, r, cornername};
+    dl_record(gfx, GFX_OP_CIRCLE_HELPER, args, 5);
+    return;
+  }
+  if (GFX_clipped(gfx, x0 - ABS(r), y0 - ABS(r), x0 + ABS(r), y0 + ABS(r))) return;
+
   int16_t f = 1 - r;
   int16_t ddF_x = 1;
   int16_t ddF_y = -2 * r;
@@ -541,6 +917,13 @@ void GFX_fillCircle(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t r,
 /**************************************************************************/
 void GFX_fillCircleHelper(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t r,
                           uint8_t corners, int16_t delta, uint16_t color) {
+  if (gfx->dl_recording) {
+    int16_t args[] = {(int16_t)color, x0, y0, r, corners, delta};
+    dl_record(gfx, GFX_OP_FILL_CIRCLE_HELPER, args, 6);
+    return;
+  }
+  int16_t ry = ABS(r) + ABS(delta) + 1;
+  if (GFX_clipped(gfx, x0 - ABS(r), y0 - ry, x0 + ABS(r), y0 + ry)) return;
 
   int16_t f = 1 - r;
   int16_t ddF_x = 1;
@@ -699,6 +1082,8 @@ void GFX_fillTriangle(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t x1,
     SWAP(x0, x1, int16_t);
   }
 
+  if (GFX_clipped(gfx, MIN(MIN(x0, x1), x2), y0, MAX(MAX(x0, x1), x2), y2)) return;
+
   if (y0 == y2) { // Handle awkward all-on-same-line case as its own thing
     a = b = x0;
     if (x1 < a)
@@ -728,7 +1113,11 @@ void GFX_fillTriangle(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t x1,
   else
     last = y1 - 1; // Skip it
 
-  for (y = y0; y <= last; y++) {
+  // start both loops at the first row of the page, the crossings only depend on y
+  y = MAX(y0, gfx->clip_y0);
+  sa = (int32_t)dx01 * (y - y0);
+  sb = (int32_t)dx02 * (y - y0);
+  for (; y <= MIN(last, gfx->clip_y1); y++) {
     a = x0 + sa / dy01;
     b = x0 + sb / dy02;
     sa += dx01;
@@ -746,7 +1135,7 @@ void GFX_fillTriangle(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t x1,
   // 0-2 and 1-2.  This loop is skipped if y1=y2.
   sa = (int32_t)dx12 * (y - y1);
   sb = (int32_t)dx02 * (y - y0);
-  for (; y <= y2; y++) {
+  for (; y <= MIN(y2, gfx->clip_y1); y++) {
     a = x1 + sa / dy12;
     b = x0 + sb / dy02;
     sa += dx12;
@@ -761,6 +1150,97 @@ void GFX_fillTriangle(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t x1,
   }
 }
 
+static const uint8_t GFX_rev4[16] = {0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE,
+                                     0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF};
+#define GFX_REV8(b) ((uint8_t)(GFX_rev4[(b) & 0xF] << 4 | GFX_rev4[(b) >> 4]))
+
+// 8 pixels of a bitmap row from column s on, MSB first, s >= -8. Bytes outside of
+// the row are not read, the bits of columns outside of it are undefined.
+static inline uint8_t GFX_bitmapBits(const uint8_t *row, int16_t bytes, int16_t s) {
+  int16_t b = (s + 8) / 8 - 1;
+  uint8_t r = (s + 8) % 8;
+  uint16_t v = b >= 0 ? row[b] << 8 : 0;
+  if (r != 0 && b + 1 < bytes) v |= row[b + 1];
+  return (uint8_t)((v << r) >> 8);
+}
+
+// Merge columns i0..i1-1 of a bitmap row into a 1 bpp plane row from bit bx on,
+// mirrored for rotation 180. Set pixels (after invert) get the fg pen, the others
+// the bg pen if opaque or stay as they are.
+static void GFX_blitRow(uint8_t *dst, const uint8_t *row, int16_t bytes, int16_t i0, int16_t i1,
+                        int16_t bx, bool mirror, uint8_t invert, uint8_t fg, uint8_t bg, bool opaque) {
+  int16_t bx1 = bx + i1 - i0 - 1;
+  uint16_t b0 = bx / 8, b1 = bx1 / 8;
+  uint8_t lmask = 0xFF >> (bx % 8);
+  uint8_t rmask = 0xFF << (7 - bx1 % 8);
+
+  // whole source bytes land on whole plane bytes, the pens copy them unchanged
+  bool copy = !mirror && opaque && (uint8_t)(fg ^ bg) == 0xFF && invert == bg && (i0 - bx) % 8 == 0;
+
+  for (uint16_t k = b0; k <= b1; k++) {
+    int16_t p = 8 * k - bx; // first plane bit of the byte, relative to bx
+    uint8_t mask = (k == b0 ? lmask : 0xFF) & (k == b1 ? rmask : 0xFF);
+    if (copy && mask == 0xFF) {
+      uint16_t n = k == b1 ? 1 : b1 - k; // up to the last byte, which may be partial
+      memcpy(&dst[k], &row[(i0 + p) / 8], n);
+      k += n - 1;
+      continue;
+    }
+    uint8_t bits = mirror ? GFX_REV8(GFX_bitmapBits(row, bytes, i1 - 8 - p))
+                          : GFX_bitmapBits(row, bytes, i0 + p);
+    bits = (bits ^ invert) & mask;
+    if (opaque)
+      dst[k] = (dst[k] & ~mask) | (fg & bits) | (bg & mask & ~bits);
+    else
+      dst[k] = (dst[k] & ~bits) | (fg & bits);
+  }
+}
+
+// Rotation 0 and 180 of BW and 3c buffers copy whole rows into the planes, the
+// rest goes pixel by pixel
+static void GFX_bitmap(Adafruit_GFX *gfx, int16_t x, int16_t y, const uint8_t bitmap[],
+                       int16_t w, int16_t h, uint16_t color, uint16_t bg, bool invert, bool opaque) {
+  int16_t byteWidth = (w + 7) / 8; // Bitmap scanline pad = whole byte
+  // rows and columns inside the current page
+  int16_t i0 = MAX(0, gfx->clip_x0 - x), i1 = MIN(w, gfx->clip_x1 - x + 1);
+  int16_t j0 = MAX(0, gfx->clip_y0 - y), j1 = MIN(h, gfx->clip_y1 - y + 1);
+  if (i0 >= i1 || j0 >= j1) return;
+
+  if (GFX_format(gfx) == GFX_FORMAT_4C || (gfx->rotation != GFX_ROTATE_0 && gfx->rotation != GFX_ROTATE_180)) {
+    for (int16_t j = j0; j < j1; j++) {
+      const uint8_t *row = &bitmap[j * byteWidth];
+      for (int16_t i = i0; i < i1; i++) {
+        if (((row[i / 8] & (0x80 >> (i & 7))) != 0) ^ invert)
+          GFX_drawPixel(gfx, x + i, y + j, color);
+        else if (opaque)
+          GFX_drawPixel(gfx, x + i, y + j, bg);
+      }
+    }
+    return;
+  }
+
+  uint8_t bg_pen[2] = {0};
+  if (opaque) {
+    GFX_setPen(gfx, bg);
+    memcpy(bg_pen, gfx->pen, sizeof(bg_pen));
+  }
+  GFX_setPen(gfx, color);
+
+  bool mirror = gfx->rotation == GFX_ROTATE_180;
+  uint16_t stride = gfx->pw / 8;
+  int16_t bx = mirror ? gfx->WIDTH - 1 - (x + i1 - 1) - gfx->px : x + i0 - gfx->px;
+  for (int16_t j = j0; j < j1; j++) {
+    const uint8_t *row = &bitmap[j * byteWidth];
+    int16_t by = (mirror ? gfx->HEIGHT - 1 - (y + j) : y + j) - gfx->page_y;
+    uint32_t offset = (uint32_t)by * stride;
+    GFX_blitRow(gfx->buffer + offset, row, byteWidth, i0, i1, bx, mirror, invert ? 0xFF : 0x00,
+                gfx->pen[0], bg_pen[0], opaque);
+    if (gfx->color != NULL) // 3c
+      GFX_blitRow(gfx->color + offset, row, byteWidth, i0, i1, bx, mirror, invert ? 0xFF : 0x00,
+                  gfx->pen[1], bg_pen[1], opaque);
+  }
+}
+
 /**************************************************************************/
 /*!
    @brief      Draw a RAM-resident 1-bit image at the specified (x,y) position,
@@ -776,20 +1256,37 @@ void GFX_fillTriangle(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t x1,
 /**************************************************************************/
 void GFX_drawBitmap(Adafruit_GFX *gfx, int16_t x, int16_t y, const uint8_t bitmap[],
                     int16_t w, int16_t h, uint16_t color, bool invert) {
+  if (gfx->dl_recording) {
+    int16_t args[6 + GFX_DL_PTR_WORDS] = {(int16_t)color, x, y, w, h, invert};
+    memcpy(&args[6], &bitmap, sizeof(const uint8_t *));
+    dl_record(gfx, GFX_OP_BITMAP, args, 6 + GFX_DL_PTR_WORDS);
+    return;
+  }
+  GFX_bitmap(gfx, x, y, bitmap, w, h, color, 0, invert, false);
+}
 
-  int16_t byteWidth = (w + 7) / 8; // Bitmap scanline pad = whole byte
-  uint8_t byte = 0;
-
-  for (int16_t j = 0; j < h; j++) {
-    for (int16_t i = 0; i < w; i++) {
-      if (i & 7)
-        byte <<= 1;
-      else
-        byte = bitmap[j * byteWidth + i / 8];
-      if (((byte & 0x80) == 0x80) ^ invert)
-        GFX_drawPixel(gfx, x + i, y + j, color);
-    }
+/**************************************************************************/
+/*!
+   @brief      Draw a RAM-resident 1-bit image at the specified (x,y) position,
+   using the specified foreground (for set bits) and background (unset bits) colors.
+    @param    x   Top left corner x coordinate
+    @param    y   Top left corner y coordinate
+    @param    bitmap  byte array with monochrome bitmap
+    @param    w   Width of bitmap in pixels
+    @param    h   Height of bitmap in pixels
+    @param    color 16-bit 5-6-5 Color to draw pixels with
+    @param    bg 16-bit 5-6-5 Color to draw background with
+*/
+/**************************************************************************/
+void GFX_drawBitmapBg(Adafruit_GFX *gfx, int16_t x, int16_t y, const uint8_t bitmap[],
+                      int16_t w, int16_t h, uint16_t color, uint16_t bg) {
+  if (gfx->dl_recording) {
+    int16_t args[6 + GFX_DL_PTR_WORDS] = {(int16_t)color, x, y, w, h, (int16_t)bg};
+    memcpy(&args[6], &bitmap, sizeof(const uint8_t *));
+    dl_record(gfx, GFX_OP_BITMAP_BG, args, 6 + GFX_DL_PTR_WORDS);
+    return;
   }
+  GFX_bitmap(gfx, x, y, bitmap, w, h, color, bg, false, true);
 }
 
 /*
@@ -860,12 +1357,28 @@ int8_t GFX_getFontDescent(Adafruit_GFX *gfx) {
   return gfx->u8g2.font_info.descent_g;
 }
 
-int16_t GFX_drawGlyph(Adafruit_GFX *gfx, int16_t x, int16_t y, uint16_t e) {
+// draw a glyph, or record it with the same advance while recording
+static int16_t GFX_glyph(Adafruit_GFX *gfx, int16_t x, int16_t y, uint16_t e) {
+  if (gfx->dl_recording) {
+    int16_t delta = u8g2_GetGlyphWidth(&gfx->u8g2, e);
+    dl_record_glyph(gfx, x, y, e, delta);
+    return delta;
+  }
   return u8g2_DrawGlyph(&gfx->u8g2, x, y, e);
 }
 
+int16_t GFX_drawGlyph(Adafruit_GFX *gfx, int16_t x, int16_t y, uint16_t e) {
+  return GFX_glyph(gfx, x, y, e);
+}
+
 int16_t GFX_drawStr(Adafruit_GFX *gfx, int16_t x, int16_t y, const char *s) {
-  return u8g2_DrawStr(&gfx->u8g2, x, y, s);
+  int16_t sum = 0;
+  while (*s != '\0') {
+    int16_t delta = GFX_glyph(gfx, x, y, (uint8_t)*s++);
+    dl_advance(gfx->u8g2.font_decode.dir, &x, &y, delta);
+    sum += delta;
+  }
+  return sum;
 }
 
 static uint16_t utf8_next(Adafruit_GFX *gfx, uint8_t b)
@@ -935,7 +1448,7 @@ int16_t GFX_drawUTF8(Adafruit_GFX *gfx, int16_t x, int16_t y, const char *str)
     str++;
     if ( e != 0x0fffe )
     {
-      delta = u8g2_DrawGlyph(&gfx->u8g2, x, y, e);
+      delta = GFX_glyph(gfx, x, y, e);
     
       switch(gfx->u8g2.font_decode.dir)
       {
@@ -992,6 +1505,23 @@ int16_t GFX_getUTF8Width(Adafruit_GFX *gfx, const char *str)
   return w;
 }
 
+// width of str in the given font, the font state and a pending UTF8 sequence are kept,
+// so a layout can be measured before it is drawn
+int16_t GFX_measureUTF8(Adafruit_GFX *gfx, const uint8_t *font, const char *str)
+{
+  u8g2_font_t u8g2 = gfx->u8g2;
+  uint8_t utf8_state = gfx->utf8_state;
+  uint16_t encoding = gfx->encoding;
+
+  u8g2_SetFont(&gfx->u8g2, font);
+  int16_t w = GFX_getUTF8Width(gfx, str);
+
+  gfx->u8g2 = u8g2;
+  gfx->utf8_state = utf8_state;
+  gfx->encoding = encoding;
+  return w;
+}
+
 size_t GFX_print(Adafruit_GFX *gfx, const char c) {
   int16_t delta;
   uint16_t e = utf8_next(gfx, (uint8_t)c);
@@ -1006,7 +1536,7 @@ size_t GFX_print(Adafruit_GFX *gfx, const char c) {
   }
   else if ( e < 0x0fffe )
   {
-    delta = u8g2_DrawGlyph(&gfx->u8g2, gfx->tx, gfx->ty, e);
+    delta = GFX_glyph(gfx, gfx->tx, gfx->ty, e);
     switch(gfx->u8g2.font_decode.dir)
     {
       case 0:
@@ -1035,29 +1565,254 @@ size_t GFX_write(Adafruit_GFX *gfx, const char *buffer, size_t size) {
   return cnt;
 }
 
+// Formatter for the subset the GUI uses: %d %i %u %x %X %c %s %%, with the 0 flag
+// and a field width. Numbers are int sized, there is no floating point.
+typedef void (*gfx_putc)(void *ctx, char c);
+
+static size_t GFX_vformat(gfx_putc put, void *ctx, const char *format, va_list va) {
+  size_t cnt = 0;
+  while (*format != '\0') {
+    char c = *format++;
+    if (c != '%') {
+      put(ctx, c);
+      cnt++;
+      continue;
+    }
+
+    char pad = ' ';
+    uint8_t width = 0;
+    if (*format == '0') {
+      pad = '0';
+      format++;
+    }
+    while (*format >= '0' && *format <= '9')
+      width = width * 10 + (*format++ - '0');
+
+    char digits[10];
+    const char *s = digits;
+    uint8_t len = 0;
+    bool minus = false;
+    switch (c = *format++) {
+      case 'd':
+      case 'i':
+      case 'u':
+      case 'x':
+      case 'X': {
+        unsigned int v = va_arg(va, unsigned int);
+        uint8_t base = (c == 'x' || c == 'X') ? 16 : 10;
+        if ((c == 'd' || c == 'i') && (int)v < 0) {
+          minus = true;
+          v = 0 - v;
+        }
+        // digits are produced backwards, they are emitted from the end
+        do {
+          uint8_t d = v % base;
+          digits[sizeof(digits) - 1 - len++] = d < 10 ? '0' + d : (c == 'x' ? 'a' : 'A') + d - 10;
+          v /= base;
+        } while (v != 0);
+        s = &digits[sizeof(digits) - len];
+      } break;
+      case 'c':
+        digits[0] = (char)va_arg(va, int);
+        len = 1;
+        break;
+      case 's':
+        s = va_arg(va, const char *);
+        if (s == NULL) s = "";
+        len = strlen(s);
+        pad = ' ';
+        break;
+      case '\0': // a lone % at the end
+        return cnt;
+      default: // %% and anything unknown is written as is
+        digits[0] = c;
+        len = 1;
+        break;
+    }
+
+    if (minus && pad == '0') {
+      put(ctx, '-');
+      cnt++;
+    }
+    for (uint8_t n = len + minus; n < width; n++, cnt++)
+      put(ctx, pad);
+    if (minus && pad != '0') {
+      put(ctx, '-');
+      cnt++;
+    }
+    for (uint8_t n = 0; n < len; n++, cnt++)
+      put(ctx, s[n]);
+  }
+  return cnt;
+}
+
+static void GFX_putGlyph(void *ctx, char c) {
+  GFX_print((Adafruit_GFX *)ctx, c);
+}
+
+// formatted text goes straight into the glyph pipeline, there is no buffer
 size_t GFX_printf(Adafruit_GFX *gfx, const char* format, ...) {
   va_list va;
-  char tmp[64] = {0};
-  char *buf = tmp;
+  va_start(va, format);
+  size_t len = GFX_vformat(GFX_putGlyph, gfx, format, va);
+  va_end(va);
+  return len;
+}
+
+typedef struct {
+  char *buf;
+  size_t size;
   size_t len;
- 
+} gfx_string_t;
+
+static void GFX_putString(void *ctx, char c) {
+  gfx_string_t *str = (gfx_string_t *)ctx;
+  if (str->len + 1 < str->size) str->buf[str->len++] = c;
+}
+
+// same format as GFX_printf into a string, for text that is measured first
+size_t GFX_snprintf(char *buf, size_t size, const char *format, ...) {
+  gfx_string_t str = {buf, size, 0};
+  va_list va;
   va_start(va, format);
-  len = vsnprintf(tmp, sizeof(tmp), format, va);
+  size_t len = GFX_vformat(GFX_putString, &str, format, va);
   va_end(va);
+  if (size > 0) buf[str.len] = '\0';
+  return len;
+}
 
-  if (len > sizeof(tmp) - 1)
-  {
-    buf = malloc(len + 1);
-    if (buf == NULL)
-      return 0;
-    va_start(va, format);
-    vsnprintf(buf, len + 1, format, va);
-    va_end(va);
+// first and last row an entry may draw, a[] are its arguments
+static void dl_rows(Adafruit_GFX *gfx, uint8_t op, const int16_t *a, int16_t *y0, int16_t *y1) {
+  int16_t m;
+  switch (op) {
+    case GFX_OP_PIXEL:
+    case GFX_OP_HLINE:
+      *y0 = *y1 = a[2];
+      return;
+    case GFX_OP_LINE:
+      *y0 = MIN(a[2], a[4]);
+      *y1 = MAX(a[2], a[4]);
+      return;
+    case GFX_OP_VLINE:
+    case GFX_OP_FILL_RECT:
+    case GFX_OP_BITMAP:
+    case GFX_OP_BITMAP_BG:
+      m = a[2] + a[op == GFX_OP_VLINE ? 3 : 4] - 1; // drawLine() draws h <= 0 upwards
+      *y0 = op == GFX_OP_VLINE || op == GFX_OP_FILL_RECT ? MIN(a[2], m) : a[2];
+      *y1 = op == GFX_OP_VLINE || op == GFX_OP_FILL_RECT ? MAX(a[2], m) : m;
+      return;
+    case GFX_OP_CIRCLE:
+    case GFX_OP_CIRCLE_HELPER:
+    case GFX_OP_FILL_CIRCLE_HELPER:
+      m = ABS(a[3]) + (op == GFX_OP_FILL_CIRCLE_HELPER ? ABS(a[5]) + 1 : 0);
+      *y0 = a[2] - m;
+      *y1 = a[2] + m;
+      return;
+    case GFX_OP_GLYPHS:
+      // font bounding box, any row for rotated text
+      if (gfx->u8g2.font_decode.dir == 0) {
+        *y0 = a[1] - (gfx->u8g2.font_info.max_char_height + gfx->u8g2.font_info.y_offset) - 1;
+        *y1 = a[1] - gfx->u8g2.font_info.y_offset;
+        return;
+      }
+      break;
   }
+  *y0 = INT16_MIN;
+  *y1 = INT16_MAX;
+}
 
-  len = GFX_write(gfx, buf, len);
-  if (buf != tmp)
-      free(buf);
- 
-  return len;
+/**************************************************************************/
+/*!
+   @brief    Draw the recorded entries which touch the current page
+*/
+/**************************************************************************/
+void GFX_replay(Adafruit_GFX *gfx) {
+  if (gfx->dl == NULL) return;
+  GFX_replayList(gfx, gfx->dl, gfx->dl_len);
+}
+
+/**************************************************************************/
+/*!
+   @brief    Draw the entries of a display list kept elsewhere (e.g. in flash)
+   which touch the current page, it must come from this firmware build
+   @param    dl   Display list taken with GFX_detachList
+   @param    len  Display list length in words
+*/
+/**************************************************************************/
+void GFX_replayList(Adafruit_GFX *gfx, const uint16_t *dl, uint16_t len) {
+  for (uint16_t i = 0; i < len; ) {
+    uint8_t op = dl[i] & 0xFF;
+    uint8_t argc = dl[i] >> 8;
+    const int16_t *a = (const int16_t *)&dl[i + 1];
+    uint16_t color = (uint16_t)a[0];
+    int16_t y0, y1;
+    i += 1 + argc;
+
+    // text state applies to everything after it, visible or not
+    if (op == GFX_OP_FONT) {
+      const uint8_t *font;
+      uint8_t is_transparent = gfx->u8g2.font_decode.is_transparent;
+      memcpy(&font, a, sizeof(font));
+      u8g2_SetFont(&gfx->u8g2, font); // the mode is part of the text color entry
+      u8g2_SetFontMode(&gfx->u8g2, is_transparent);
+      continue;
+    }
+    if (op == GFX_OP_TEXT_COLOR) {
+      u8g2_SetForegroundColor(&gfx->u8g2, color);
+      u8g2_SetBackgroundColor(&gfx->u8g2, (uint16_t)a[1]);
+      u8g2_SetFontMode(&gfx->u8g2, a[2] & 0xFF);
+      u8g2_SetFontDirection(&gfx->u8g2, (uint16_t)a[2] >> 8);
+      continue;
+    }
+
+    dl_rows(gfx, op, a, &y0, &y1);
+    if (y1 < gfx->clip_y0 || y0 > gfx->clip_y1) continue;
+
+    switch (op) {
+      case GFX_OP_PIXEL:
+        GFX_drawPixel(gfx, a[1], a[2], color);
+        break;
+      case GFX_OP_LINE:
+        GFX_drawLine(gfx, a[1], a[2], a[3], a[4], color);
+        break;
+      case GFX_OP_HLINE:
+        GFX_drawFastHLine(gfx, a[1], a[2], a[3], color);
+        break;
+      case GFX_OP_VLINE:
+        GFX_drawFastVLine(gfx, a[1], a[2], a[3], color);
+        break;
+      case GFX_OP_FILL_RECT:
+        GFX_fillRect(gfx, a[1], a[2], a[3], a[4], color);
+        break;
+      case GFX_OP_FILL_SCREEN:
+        GFX_fillScreen(gfx, color);
+        break;
+      case GFX_OP_CIRCLE:
+        GFX_drawCircle(gfx, a[1], a[2], a[3], color);
+        break;
+      case GFX_OP_CIRCLE_HELPER:
+        GFX_drawCircleHelper(gfx, a[1], a[2], a[3], (uint8_t)a[4], color);
+        break;
+      case GFX_OP_FILL_CIRCLE_HELPER:
+        GFX_fillCircleHelper(gfx, a[1], a[2], a[3], (uint8_t)a[4], a[5], color);
+        break;
+      case GFX_OP_BITMAP: {
+        const uint8_t *bitmap;
+        memcpy(&bitmap, &a[6], sizeof(bitmap));
+        GFX_drawBitmap(gfx, a[1], a[2], bitmap, a[3], a[4], color, a[5] != 0);
+      } break;
+      case GFX_OP_BITMAP_BG: {
+        const uint8_t *bitmap;
+        memcpy(&bitmap, &a[6], sizeof(bitmap));
+        GFX_drawBitmapBg(gfx, a[1], a[2], bitmap, a[3], a[4], color, (uint16_t)a[5]);
+      } break;
+      case GFX_OP_GLYPHS: {
+        int16_t x = a[0], y = a[1];
+        for (uint8_t n = 2; n < argc; n++) {
+          int16_t delta = u8g2_DrawGlyph(&gfx->u8g2, x, y, (uint16_t)a[n]);
+          dl_advance(gfx->u8g2.font_decode.dir, &x, &y, delta);
+        }
+      } break;
+    }
+  }
 }
@@ -24,7 +24,12 @@ typedef enum {
 } GFX_Rotate;
 
 // GRAPHICS CONTEXT
-typedef struct {
+typedef struct _Adafruit_GFX Adafruit_GFX;
+
+// Writes the pen to a pixel inside the clip box, one per buffer format and rotation
+typedef void (*gfx_pixel_writer)(Adafruit_GFX *gfx, int16_t x, int16_t y);
+
+struct _Adafruit_GFX {
   int16_t WIDTH;             // This is the 'raw' display width - never changes
   int16_t HEIGHT;            // This is the 'raw' display height - never changes
   int16_t _width;            // Display width as modified by current rotation
@@ -42,18 +47,44 @@ typedef struct {
   int16_t page_height;       // height to be drawn in one page
   int16_t current_page;      // index of the current drawing page
   int16_t total_pages;       // total number of pages to be drawn
-} Adafruit_GFX;
+  int16_t clip_x0, clip_y0;  // part of the current page inside the display,
+  int16_t clip_x1, clip_y1;  // in rotated coordinates
+  int16_t page_y;            // first display row of the current page
+  gfx_pixel_writer write_pixel; // picked by the buffer format and rotation
+  uint16_t pen_color;        // color the pen was made for
+  uint8_t pen[2];            // pen_color as a byte of pixels for the buffer and the color plane
+
+  uint16_t *dl;              // display list, draw calls recorded for replay on every page
+  uint16_t dl_size;          // display list capacity in words
+  uint16_t dl_len;           // display list words used
+  uint16_t dl_run;           // glyph run being recorded, GFX_DL_NONE if none
+  uint16_t dl_font;          // last recorded font entry
+  uint16_t dl_color;         // last recorded text color entry
+  int16_t dl_run_x, dl_run_y; // pen position where the glyph run continues
+  bool dl_recording;         // draw calls are recorded instead of drawn
+  bool dl_overflow;          // display list was too small, it can not be replayed
+};
+
+#define GFX_DL_NONE   0xFFFF
 
 // CONTROL API
-void GFX_begin(Adafruit_GFX *gfx, int16_t w, int16_t h, int16_t buffer_height);
-void GFX_begin_3c(Adafruit_GFX *gfx, int16_t w, int16_t h, int16_t buffer_height);
-void GFX_begin_4c(Adafruit_GFX *gfx, int16_t w, int16_t h, int16_t buffer_height);
+bool GFX_begin(Adafruit_GFX *gfx, int16_t w, int16_t h, uint8_t *buffer, uint32_t size);
+bool GFX_begin_3c(Adafruit_GFX *gfx, int16_t w, int16_t h, uint8_t *buffer, uint32_t size);
+bool GFX_begin_4c(Adafruit_GFX *gfx, int16_t w, int16_t h, uint8_t *buffer, uint32_t size);
+bool GFX_setBuffer(Adafruit_GFX *gfx, uint8_t *buffer, uint32_t size);
 void GFX_setRotation(Adafruit_GFX *gfx, GFX_Rotate r);
 void GFX_setWindow(Adafruit_GFX *gfx, uint16_t x, uint16_t y, uint16_t w, uint16_t h);
 void GFX_firstPage(Adafruit_GFX *gfx);
 bool GFX_nextPage(Adafruit_GFX *gfx, buffer_callback callback);
 void GFX_end(Adafruit_GFX *gfx);
 
+// DISPLAY LIST API
+bool GFX_beginRecord(Adafruit_GFX *gfx, uint16_t *list, uint16_t size);
+bool GFX_endRecord(Adafruit_GFX *gfx);
+void GFX_replay(Adafruit_GFX *gfx);
+void GFX_replayList(Adafruit_GFX *gfx, const uint16_t *dl, uint16_t len);
+uint16_t *GFX_detachList(Adafruit_GFX *gfx, uint16_t *len);
+
 // DRAW API
 void GFX_drawPixel(Adafruit_GFX *gfx, int16_t x, int16_t y, uint16_t color);
 void GFX_drawLine(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
@@ -78,6 +109,8 @@ void GFX_fillRoundRect(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t w, int
                        int16_t radius, uint16_t color);
 void GFX_drawBitmap(Adafruit_GFX *gfx, int16_t x, int16_t y, const uint8_t bitmap[], int16_t w,
                     int16_t h, uint16_t color, bool invert);
+void GFX_drawBitmapBg(Adafruit_GFX *gfx, int16_t x, int16_t y, const uint8_t bitmap[], int16_t w,
+                      int16_t h, uint16_t color, uint16_t bg);
 
 // U8G2 FONT API
 void GFX_setCursor(Adafruit_GFX *gfx, int16_t x, int16_t y);
@@ -91,8 +124,10 @@ int16_t GFX_drawGlyph(Adafruit_GFX *gfx, int16_t x, int16_t y, uint16_t e);
 int16_t GFX_drawStr(Adafruit_GFX *gfx, int16_t x, int16_t y, const char *s);
 int16_t GFX_drawUTF8(Adafruit_GFX *gfx, int16_t x, int16_t y, const char *str);
 int16_t GFX_getUTF8Width(Adafruit_GFX *gfx, const char *str);
+int16_t GFX_measureUTF8(Adafruit_GFX *gfx, const uint8_t *font, const char *str);
 size_t GFX_print(Adafruit_GFX *gfx, const char c);
 size_t GFX_write(Adafruit_GFX *gfx, const char *buffer, size_t size);
 size_t GFX_printf(Adafruit_GFX *gfx, const char* format, ...);
+size_t GFX_snprintf(char *buf, size_t size, const char *format, ...);
 
 #endif // _ADAFRUIT_GFX_H
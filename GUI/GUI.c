@@ -1,8 +1,6 @@
 #include "fonts.h"
 #include "Lunar.h"
 #include "GUI.h"
-#include <time.h>
-#include <stdio.h>
 
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
 #define GFX_printf_styled(gfx, fg, bg, font, ...) \
@@ -48,94 +46,210 @@ static const Festival festivals_lunar[] = {
     {12, 30, "除夕"  },
 };
 
-// 放假和调休数据，每年更新
+// 内置的放假和调休数据，其他年份通过蓝牙下发 (EPD_CMD_SET_HOLIDAYS)
+#define D(day) (1UL << ((day) - 1))
 #define HOLIDAY_YEAR 2025
-static const uint16_t holidays[] = {
-    0x0101, 0x111A, 0x011C, 0x011D, 0x011E, 0x011F, 0x0201, 0x0202,
-    0x0202, 0x0203, 0x0204, 0x1208, 0x0404, 0x0405, 0x0406, 0x141B,
-    0x0501, 0x0502, 0x0503, 0x0504, 0x0505, 0x051F, 0x0601, 0x0602,
-    0x191C, 0x0A01, 0x0A02, 0x0A03, 0x0A04, 0x0A05, 0x0A06, 0x0A07,
-    0x0A08, 0x1A0B,
+static const uint32_t holidays[12][2] = { // 放假, 调休上班
+    {D(1) | D(28) | D(29) | D(30) | D(31), D(26)},
+    {D(1) | D(2) | D(3) | D(4), D(8)},
+    {0, 0},
+    {D(4) | D(5) | D(6), D(27)},
+    {D(1) | D(2) | D(3) | D(4) | D(5) | D(31), 0},
+    {D(1) | D(2), 0},
+    {0, 0},
+    {0, 0},
+    {0, D(28)},
+    {D(1) | D(2) | D(3) | D(4) | D(5) | D(6) | D(7) | D(8), D(11)},
+    {0, 0},
+    {0, 0},
+};
+#undef D
+
+enum {
+    FESTIVAL_NONE = 0,
+    FESTIVAL_LUNAR,                                           // + index in festivals_lunar
+    FESTIVAL_EVE = FESTIVAL_LUNAR + ARRAY_SIZE(festivals_lunar),
+    FESTIVAL_MOTHERS_DAY,
+    FESTIVAL_FATHERS_DAY,
+    FESTIVAL_THANKSGIVING,
+    FESTIVAL_SOLAR,                                           // + index in festivals
+    FESTIVAL_JIEQI = FESTIVAL_SOLAR + ARRAY_SIZE(festivals),  // + index in JieQiStr
+};
+
+enum {
+    HOLIDAY_NONE = 0,
+    HOLIDAY_OFF,
+    HOLIDAY_WORK,
 };
 
-static bool GetHoliday(uint8_t mon, uint8_t day, bool *work)
+// Everything the calendar shows for a day
+typedef struct {
+    uint8_t lunar_month;     // 0 outside of the lunar table
+    uint8_t lunar_date;
+    uint8_t lunar_leap : 1;
+    uint8_t week : 3;        // 0: Sunday
+    uint8_t holiday : 2;     // HOLIDAY_*
+    uint8_t festival;        // FESTIVAL_*
+} day_info_t;
+
+// Computed once per render, the page passes only read it
+typedef struct {
+    uint16_t year;
+    uint8_t month;
+    uint8_t first_week;      // weekday of the 1st
+    uint8_t days;
+    uint32_t holiday_off;    // bit d-1: day d is a holiday
+    uint32_t holiday_work;   // bit d-1: day d is a make-up working day
+    day_info_t day[31];
+} month_info_t;
+
+// Text widths the layout needs, measured once per render instead of on every page
+typedef struct {
+    int16_t voltage;         // "3.2V", the battery text is right-aligned to it
+    int16_t ssid;
+    int16_t weekday;         // a name of the week header
+    int16_t sync_title;
+    int16_t sync_url;
+    uint8_t jieqi;           // next solar term, clock only
+    uint8_t jieqi_days;      // days until it, 0 on the day
+    int16_t jieqi_name;      // "小暑" on the day, "离小暑" before it
+    int16_t jieqi_left;      // "还有N天"
+} text_layout_t;
+
+// The saved years come first, the built-in one is the fallback
+static void GetHolidays(uint16_t year, uint8_t mon, gui_data_t *data, uint32_t *off, uint32_t *work)
 {
-    for (uint8_t i = 0; i < ARRAY_SIZE(holidays); i++) {
-        if (((holidays[i] >> 8) & 0xF) == mon && (holidays[i] & 0xFF) == day) {
-            *work = ((holidays[i] >> 12) & 0xF) > 0;
-            return true;
-        }
+    *off = *work = 0;
+    if (data->holidays != NULL && data->holidays(year, mon, off, work))
+        return;
+    if (year == HOLIDAY_YEAR) {
+        *off = holidays[mon - 1][0];
+        *work = holidays[mon - 1][1];
     }
-    return false;
 }
 
-static bool GetFestival(uint16_t year, uint8_t mon, uint8_t day, uint8_t week,
-                        struct Lunar_Date *Lunar, char *festival)
+// jieqi: day of the solar term in this half of the month, 0 if unknown.
+// next: lunar date of the following day.
+static uint8_t GetFestival(uint8_t mon, uint8_t day, uint8_t week, uint8_t jieqi,
+                           struct Lunar_Date *Lunar, struct Lunar_Date *next)
 {
     // 农历节日
     for (uint8_t i = 0; i < ARRAY_SIZE(festivals_lunar); i++) {
-        if (Lunar->Month == festivals_lunar[i].month && Lunar->Date == festivals_lunar[i].day) {
-            strcpy(festival, festivals_lunar[i].name);
-            return true;
-        }
+        if (Lunar->Month == festivals_lunar[i].month && Lunar->Date == festivals_lunar[i].day)
+            return FESTIVAL_LUNAR + i;
     }
 
     // 除夕：春节前一天（12/29 或 12/30），12/30 已在上面判断
-    if (Lunar->Month == 12 && Lunar->Date == 29) {
-        struct Lunar_Date nextLunar;
-        struct devtm tm = {year, mon, day, 0, 0, 0, week};
-        transformTime(transformTimeStruct(&tm) + 86400, &tm);
-        LUNAR_SolarToLunar(&nextLunar, tm.tm_year + YEAR0, tm.tm_mon + 1, tm.tm_mday);
-        if (nextLunar.Month == 1 && nextLunar.Date == 1) {
-            strcpy(festival, "除夕");
-            return true;
-        }
-    }
+    if (Lunar->Month == 12 && Lunar->Date == 29 && next->Month == 1 && next->Date == 1)
+        return FESTIVAL_EVE;
     // 母亲节: 五月第二个星期日
-    if (mon == 5 && week == 0 && day >= 8 && day <= 14) {
-        strcpy(festival, "母亲节");
-        return true;
-    }
+    if (mon == 5 && week == 0 && day >= 8 && day <= 14)
+        return FESTIVAL_MOTHERS_DAY;
     // 父亲节: 六月第三个星期日
-    if (mon == 6 && week == 0 && day >= 15 && day <= 21) {
-        strcpy(festival, "父亲节");
-        return true;
-    }
+    if (mon == 6 && week == 0 && day >= 15 && day <= 21)
+        return FESTIVAL_FATHERS_DAY;
     // 感恩节：十一月第四个星期四
-    if (mon == 11 && week == 4 && day >= 22 && day <= 28) {
-        strcpy(festival, "感恩节");
-        return true;
-    }
+    if (mon == 11 && week == 4 && day >= 22 && day <= 28)
+        return FESTIVAL_THANKSGIVING;
 
     // 公历节日
     for (uint8_t i = 0; i < ARRAY_SIZE(festivals); i++) {
-        if (mon == festivals[i].month && day == festivals[i].day) {
-            strcpy(festival, festivals[i].name);
-            return true;
-        }
+        if (mon == festivals[i].month && day == festivals[i].day)
+            return FESTIVAL_SOLAR + i;
     }
 
     // 二十四节气
-    uint8_t JQdate;
-    if (GetJieQi(year, mon, day, &JQdate) && JQdate == day) {
-        uint8_t JQ = (mon - 1) * 2;
-        if (day >= 15) JQ++;
-        strcpy(festival, JieQiStr[JQ]);
-        if (JQ == 6) // 清明
-            strcat(festival, "节");
-            
-        return true;
+    if (jieqi == day)
+        return FESTIVAL_JIEQI + (mon - 1) * 2 + (day >= 15);
+
+    return FESTIVAL_NONE;
+}
+
+static void GetFestivalName(uint8_t festival, char *name)
+{
+    if (festival >= FESTIVAL_JIEQI) {
+        strcpy(name, JieQiStr[festival - FESTIVAL_JIEQI]);
+        if (festival - FESTIVAL_JIEQI == 6) // 清明
+            strcat(name, "节");
+    } else if (festival >= FESTIVAL_SOLAR) {
+        strcpy(name, festivals[festival - FESTIVAL_SOLAR].name);
+    } else if (festival == FESTIVAL_THANKSGIVING) {
+        strcpy(name, "感恩节");
+    } else if (festival == FESTIVAL_FATHERS_DAY) {
+        strcpy(name, "父亲节");
+    } else if (festival == FESTIVAL_MOTHERS_DAY) {
+        strcpy(name, "母亲节");
+    } else if (festival == FESTIVAL_EVE) {
+        strcpy(name, "除夕");
+    } else if (festival >= FESTIVAL_LUNAR) {
+        strcpy(name, festivals_lunar[festival - FESTIVAL_LUNAR].name);
+    } else {
+        name[0] = '\0';
     }
+}
+
+// The lunar dates follow the first one day by day instead of being converted one by one
+static void GetMonthInfo(month_info_t *info, uint16_t year, uint8_t month, gui_data_t *data)
+{
+    struct Lunar_Date Lunar, next;
+    uint8_t jieqi[2] = {0, 0};
+
+    info->year = year;
+    info->month = month;
+    info->first_week = get_first_day_week(year, month);
+    info->days = days_in_month(year, month);
+    GetHolidays(year, month, data, &info->holiday_off, &info->holiday_work);
+
+    GetJieQi(year, month, 1, &jieqi[0]);
+    GetJieQi(year, month, 15, &jieqi[1]);
 
-    return false;
+    LUNAR_SolarToLunar(&Lunar, year, month, 1);
+    for (uint8_t i = 0; i < info->days; i++) {
+        day_info_t *d = &info->day[i];
+        uint8_t day = i + 1;
+
+        next = Lunar;
+        LUNAR_NextDay(&next);
+
+        d->lunar_month = Lunar.Month;
+        d->lunar_date = Lunar.Date;
+        d->lunar_leap = Lunar.IsLeap;
+        d->week = (info->first_week + i) % 7;
+        d->holiday = (info->holiday_work >> i) & 1 ? HOLIDAY_WORK :
+                     (info->holiday_off >> i) & 1 ? HOLIDAY_OFF : HOLIDAY_NONE;
+        d->festival = GetFestival(month, day, d->week, jieqi[day >= 15], &Lunar, &next);
+
+        Lunar = next;
+    }
 }
 
-static void DrawTimeSyncTip(Adafruit_GFX *gfx, gui_data_t *data)
+static const char SyncTitle[] = "SYNC TIME!";
+static const char SyncUrl[] = "https://tsl0922.github.io/EPD-nRF5";
+
+static void GetTextLayout(Adafruit_GFX *gfx, text_layout_t *text, tm_t *tm, gui_data_t *data, display_mode_t mode)
 {
-    const char *title = "SYNC TIME!";
-    const char *url = "https://tsl0922.github.io/EPD-nRF5";
+    const uint8_t *font = u8g2_font_wqy9_t_lunar;
+
+    text->voltage = GFX_measureUTF8(gfx, font, "3.2V");
+    text->ssid = GFX_measureUTF8(gfx, font, data->ssid);
+    text->weekday = GFX_measureUTF8(gfx, font, Lunar_DayString[0]);
+    text->sync_title = GFX_measureUTF8(gfx, font, SyncTitle);
+    text->sync_url = GFX_measureUTF8(gfx, font, SyncUrl);
+
+    if (mode == MODE_CLOCK) {
+        uint8_t day = 0;
+        text->jieqi = GetJieQiStr(tm->tm_year + YEAR0, tm->tm_mon + 1, tm->tm_mday, &day) % 24;
+        text->jieqi_days = day;
+        text->jieqi_name = GFX_measureUTF8(gfx, font, day == 0 ? "小暑" : "离小暑");
+        char buf[15] = {0};
+        GFX_snprintf(buf, sizeof(buf), "还有%d天", day);
+        text->jieqi_left = GFX_measureUTF8(gfx, font, buf);
+    }
+}
 
-    int16_t box_w = GFX_getUTF8Width(gfx, url) + 20;
+static void DrawTimeSyncTip(Adafruit_GFX *gfx, text_layout_t *text, gui_data_t *data)
+{
+    int16_t box_w = text->sync_url + 20;
     int16_t box_h = 50;
     int16_t box_x = (data->width - box_w) / 2;
     int16_t box_y = data->height / 2 - box_h / 2;
@@ -144,20 +258,21 @@ static void DrawTimeSyncTip(Adafruit_GFX *gfx, gui_data_t *data)
     GFX_fillRect(gfx, box_x, box_y, box_w, box_h, GFX_WHITE);
     GFX_drawRoundRect(gfx, box_x, box_y, box_w, box_h, 5, GFX_BLACK);
     GFX_setTextColor(gfx, GFX_RED, GFX_WHITE);
-    GFX_setCursor(gfx, box_x + (box_w - GFX_getUTF8Width(gfx, title)) / 2, 145);
-    GFX_printf(gfx, title);
+    GFX_setCursor(gfx, box_x + (box_w - text->sync_title) / 2, 145);
+    GFX_printf(gfx, SyncTitle);
     GFX_setTextColor(gfx, GFX_BLACK, GFX_WHITE);
     GFX_setCursor(gfx, box_x + 10, 164);
-    GFX_printf(gfx, url);
+    GFX_printf(gfx, SyncUrl);
 }
 
-static void DrawBattery(Adafruit_GFX *gfx, int16_t x, int16_t y, uint8_t iw, float voltage)
+static void DrawBattery(Adafruit_GFX *gfx, int16_t x, int16_t y, uint8_t iw, text_layout_t *text, uint16_t voltage, uint8_t level)
 {
     x -= iw;
-    uint8_t level = (uint8_t)(voltage * 100 / 3.6f);
+    if (level > 100) level = 100;
     GFX_setFont(gfx, u8g2_font_wqy9_t_lunar);
-    GFX_setCursor(gfx, x - GFX_getUTF8Width(gfx, "3.2V") - 2, y + 9);
-    GFX_printf(gfx, "%.1fV", voltage);
+    GFX_setCursor(gfx, x - text->voltage - 2, y + 9);
+    uint16_t dv = (voltage + 50) / 100; // rounded to 0.1V
+    GFX_printf(gfx, "%d.%dV", dv / 10, dv % 10);
     GFX_fillRect(gfx, x, y, iw, 10, GFX_WHITE);
     GFX_drawRect(gfx, x, y, iw, 10, GFX_BLACK);
     GFX_fillRect(gfx, x + iw, y + 4, 2, 2, GFX_BLACK);
@@ -171,38 +286,29 @@ static void DrawTemperature(Adafruit_GFX *gfx, int16_t x, int16_t y, int8_t temp
     GFX_printf(gfx, "%d℃", temp);
 }
 
-static uint8_t GetWeekOfYear(uint8_t year, uint8_t mon, uint8_t mday, uint8_t wday)
-{
-    struct tm tm = {0};
-    tm.tm_year = year;
-    tm.tm_mon = mon;
-    tm.tm_mday = mday;
-    tm.tm_wday = wday;
-    tm.tm_isdst = -1;
-    mktime(&tm);
-    char buffer[3] = {0};
-    strftime(buffer, 3, "%V", &tm);
-    return atoi(buffer);
-}
-
-static void DrawDateHeader(Adafruit_GFX *gfx, int16_t x, int16_t y, tm_t *tm, struct Lunar_Date *Lunar, gui_data_t *data)
+static int16_t DrawMonthTitle(Adafruit_GFX *gfx, int16_t x, int16_t y, tm_t *tm)
 {
     GFX_setCursor(gfx, x, y - 2);
     GFX_printf_styled(gfx, GFX_RED, GFX_WHITE, u8g2_font_helvB18_tn, "%d", tm->tm_year + YEAR0);
     GFX_printf_styled(gfx, GFX_BLACK, GFX_WHITE, u8g2_font_wqy12_t_lunar, "年");
     GFX_printf_styled(gfx, GFX_RED, GFX_WHITE, u8g2_font_helvB18_tn, "%d", tm->tm_mon + 1);
     GFX_printf_styled(gfx, GFX_BLACK, GFX_WHITE, u8g2_font_wqy12_t_lunar, "月");
+    return gfx->tx;
+}
 
-    int16_t tx = gfx->tx;
+static void DrawDateInfo(Adafruit_GFX *gfx, int16_t tx, int16_t y, tm_t *tm, struct Lunar_Date *Lunar,
+                         text_layout_t *text, gui_data_t *data)
+{
     int16_t ty = y;
 
     GFX_setFont(gfx, u8g2_font_wqy9_t_lunar);
+    GFX_setTextColor(gfx, GFX_BLACK, GFX_WHITE);
     GFX_setCursor(gfx, tx, ty);
     if (Lunar->IsLeap) GFX_printf(gfx, " ");
     GFX_printf(gfx, "%s%s%s", Lunar_MonthLeapString[Lunar->IsLeap], Lunar_MonthString[Lunar->Month],
                      Lunar_DateString[Lunar->Date]);
     GFX_setTextColor(gfx, GFX_RED, GFX_WHITE);
-    GFX_printf(gfx, " [%d周]", GetWeekOfYear(tm->tm_year, tm->tm_mon, tm->tm_mday, tm->tm_wday));
+    GFX_printf(gfx, " [%d周]", iso_week(tm->tm_year + YEAR0, tm->tm_mon + 1, tm->tm_mday));
  
     GFX_setCursor(gfx, tx, ty - 14);
     GFX_setTextColor(gfx, GFX_BLACK, GFX_WHITE);
@@ -211,17 +317,24 @@ static void DrawDateHeader(Adafruit_GFX *gfx, int16_t x, int16_t y, tm_t *tm, st
     GFX_printf(gfx, " [%s]", Lunar_ZodiacString[LUNAR_GetZodiac(Lunar)]);
 
     GFX_setTextColor(gfx, GFX_BLACK, GFX_WHITE);
-    DrawBattery(gfx, data->width - 10 - 2, 6, 20, data->voltage);
-    GFX_setCursor(gfx, data->width - GFX_getUTF8Width(gfx, data->ssid) - 10, y);
+    DrawBattery(gfx, data->width - 10 - 2, 6, 20, text, data->voltage, data->battery);
+    GFX_setCursor(gfx, data->width - text->ssid - 10, y);
     GFX_printf(gfx, "%s", data->ssid);
 }
 
-static void DrawWeekHeader(Adafruit_GFX *gfx, int16_t x, int16_t y, gui_data_t *data)
+static void DrawDateHeader(Adafruit_GFX *gfx, int16_t x, int16_t y, tm_t *tm, struct Lunar_Date *Lunar,
+                           text_layout_t *text, gui_data_t *data)
+{
+    int16_t tx = DrawMonthTitle(gfx, x, y, tm);
+    DrawDateInfo(gfx, tx, y, tm, Lunar, text, data);
+}
+
+static void DrawWeekHeader(Adafruit_GFX *gfx, int16_t x, int16_t y, text_layout_t *text, gui_data_t *data)
 {
     GFX_setFont(gfx, u8g2_font_wqy9_t_lunar);
     uint8_t w = (data->width - 2 * x) / 7;
     uint8_t r = (data->width - 2 * x) % 7;
-    int16_t cw = GFX_getUTF8Width(gfx, Lunar_DayString[0]);
+    int16_t cw = text->weekday;
     for (int i = 0; i < 7; i++) {
         uint8_t day = (data->week_start + i) % 7;
         uint16_t bg = (day == 0 || day == 6) ? GFX_RED : GFX_BLACK;
@@ -232,29 +345,33 @@ static void DrawWeekHeader(Adafruit_GFX *gfx, int16_t x, int16_t y, gui_data_t *
     }
 }
 
-static void DrawMonthDays(Adafruit_GFX *gfx, int16_t x, int16_t y, tm_t *tm, struct Lunar_Date *Lunar, gui_data_t *data)
+// today is highlighted, 0 for none. With only_today set just today is drawn, over the
+// plain day of a saved calendar layer.
+static void DrawMonthDays(Adafruit_GFX *gfx, int16_t x, int16_t y, month_info_t *info, uint8_t today, bool only_today, gui_data_t *data)
 {
-    uint8_t firstDayWeek = get_first_day_week(tm->tm_year + YEAR0, tm->tm_mon + 1);
-    int8_t adjustedFirstDay = (firstDayWeek - data->week_start + 7) % 7;
-    uint8_t monthMaxDays = thisMonthMaxDays(tm->tm_year + YEAR0, tm->tm_mon + 1);
-    uint8_t monthDayRows = 1 + (monthMaxDays - (7 - adjustedFirstDay) + 6) / 7;
+    int8_t adjustedFirstDay = (info->first_week - data->week_start + 7) % 7;
+    uint8_t monthDayRows = 1 + (info->days - (7 - adjustedFirstDay) + 6) / 7;
 
     int16_t bw = (data->width - x - 10) / 7;
     int16_t bh = (data->height - y - 10) / monthDayRows;
 
-    for (uint8_t i = 0; i < monthMaxDays; i++) {
-        uint16_t year = tm->tm_year + YEAR0;
-        uint8_t month = tm->tm_mon + 1;
+    for (uint8_t i = 0; i < info->days; i++) {
+        day_info_t *d = &info->day[i];
         uint8_t day = i + 1;
 
-        int16_t actualWeek = (firstDayWeek + i) % 7;
+        if (only_today && day != today) continue;
+
         int16_t displayWeek = (adjustedFirstDay + i) % 7;
-        bool weekend = (actualWeek  == 0) || (actualWeek == 6);
+        bool weekend = (d->week == 0) || (d->week == 6);
 
         int16_t bx = x + 16 + displayWeek * bw;
         int16_t by = y + 20 + (i + adjustedFirstDay) / 7 * (monthDayRows > 5 ? bh - 1 : bh);
 
-        if (day == tm->tm_mday) {
+        // the box around the highlight, no other day draws into it
+        if (only_today)
+            GFX_fillRect(gfx, bx - 11, by - 11, 50, 45, GFX_WHITE);
+
+        if (day == today) {
             GFX_fillCircle(gfx, bx + 11, by + 11, 22, GFX_RED);
             GFX_setTextColor(gfx, GFX_WHITE, GFX_RED);
         } else {
@@ -266,25 +383,25 @@ static void DrawMonthDays(Adafruit_GFX *gfx, int16_t x, int16_t y, tm_t *tm, str
         GFX_printf(gfx, "%d", day);
         
         GFX_setFont(gfx, u8g2_font_wqy9_t_lunar);
-        LUNAR_SolarToLunar(Lunar, year, month, day);
 
-        char festival[10] = {0};
-        if (GetFestival(year, month, day, actualWeek, Lunar, festival)) {
-            if (day != tm->tm_mday) GFX_setTextColor(gfx, GFX_RED, GFX_WHITE);
+        if (d->festival != FESTIVAL_NONE) {
+            char festival[10];
+            GetFestivalName(d->festival, festival);
+            if (day != today) GFX_setTextColor(gfx, GFX_RED, GFX_WHITE);
             GFX_setCursor(gfx, strlen(festival) > 6 ? bx - 6 : bx, by + 24);
             GFX_printf(gfx, "%s", festival);
         } else {
-            if (Lunar->Date == 1) {
+            if (d->lunar_date == 1) {
                 GFX_setCursor(gfx, bx - 5, by + 24);
-                GFX_printf(gfx, "%s%s", Lunar_MonthLeapString[Lunar->IsLeap], Lunar_MonthString[Lunar->Month]);
+                GFX_printf(gfx, "%s%s", Lunar_MonthLeapString[d->lunar_leap], Lunar_MonthString[d->lunar_month]);
             } else {
                 GFX_setCursor(gfx, bx, by + 24);
-                GFX_printf(gfx, "%s", Lunar_DateString[Lunar->Date]);
+                GFX_printf(gfx, "%s", Lunar_DateString[d->lunar_date]);
             }
         }
-        bool work = false;
-        if (year == HOLIDAY_YEAR && GetHoliday(month, day, &work)) {
-            if (day == tm->tm_mday) {
+        if (d->holiday != HOLIDAY_NONE) {
+            bool work = d->holiday == HOLIDAY_WORK;
+            if (day == today) {
                 GFX_fillCircle(gfx, bx + 30, by + 1, 8, GFX_WHITE);
                 GFX_drawCircle(gfx, bx + 30, by + 1, 8, GFX_RED);
             }
@@ -295,11 +412,31 @@ static void DrawMonthDays(Adafruit_GFX *gfx, int16_t x, int16_t y, tm_t *tm, str
     }
 }
 
-static void DrawCalendar(Adafruit_GFX *gfx, tm_t *tm, struct Lunar_Date *Lunar, gui_data_t *data)
+static void DrawCalendar(Adafruit_GFX *gfx, tm_t *tm, struct Lunar_Date *Lunar, month_info_t *month,
+                         text_layout_t *text, gui_data_t *data)
+{
+    DrawDateHeader(gfx, 10, 28, tm, Lunar, text, data);
+    DrawWeekHeader(gfx, 10, 32, text, data);
+    DrawMonthDays(gfx, 10, 50, month, tm->tm_mday, false, data);
+}
+
+// The part of the calendar that only changes with the month, saved as the calendar layer.
+// Returns where the date header continues.
+static int16_t DrawCalendarMonth(Adafruit_GFX *gfx, tm_t *tm, month_info_t *month, text_layout_t *text,
+                                 gui_data_t *data)
 {
-    DrawDateHeader(gfx, 10, 28, tm, Lunar, data);
-    DrawWeekHeader(gfx, 10, 32, data);
-    DrawMonthDays(gfx, 10, 50, tm, Lunar, data);
+    int16_t tx = DrawMonthTitle(gfx, 10, 28, tm);
+    DrawWeekHeader(gfx, 10, 32, text, data);
+    DrawMonthDays(gfx, 10, 50, month, 0, false, data);
+    return tx;
+}
+
+// The rest of the calendar, drawn over the calendar layer
+static void DrawCalendarToday(Adafruit_GFX *gfx, tm_t *tm, struct Lunar_Date *Lunar, month_info_t *month,
+                              int16_t tx, text_layout_t *text, gui_data_t *data)
+{
+    DrawDateInfo(gfx, tx, 28, tm, Lunar, text, data);
+    DrawMonthDays(gfx, 10, 50, month, tm->tm_mday, true, data);
 }
 
 /* Routine to Draw Large 7-Segment formated number
@@ -342,7 +479,7 @@ static void DrawTime(Adafruit_GFX *gfx, tm_t *tm, int16_t x, int16_t y, uint16_t
     Draw7Number(gfx, tm->tm_min, x, y, cS, GFX_BLACK, GFX_WHITE, nD);
 }
 
-static void DrawClock(Adafruit_GFX *gfx, tm_t *tm, struct Lunar_Date *Lunar, gui_data_t *data)
+static void DrawClock(Adafruit_GFX *gfx, tm_t *tm, struct Lunar_Date *Lunar, text_layout_t *text, gui_data_t *data)
 {
     GFX_setCursor(gfx, 40, 36);
     GFX_printf_styled(gfx, GFX_RED, GFX_WHITE, u8g2_font_helvB18_tn, "%d", tm->tm_year + YEAR0);
@@ -359,7 +496,7 @@ static void DrawClock(Adafruit_GFX *gfx, tm_t *tm, struct Lunar_Date *Lunar, gui
     GFX_printf(gfx, "%s%s%s", Lunar_MonthLeapString[Lunar->IsLeap], Lunar_MonthString[Lunar->Month],
         Lunar_DateString[Lunar->Date]);
 
-    DrawBattery(gfx, 30 + 330 - 10, 25, 20, data->voltage);
+    DrawBattery(gfx, 30 + 330 - 10, 25, 20, text, data->voltage, data->battery);
     DrawTemperature(gfx, 330, 58, data->temperature);
 
     GFX_drawFastHLine(gfx, 30, 68, 330, GFX_BLACK);
@@ -375,66 +512,193 @@ static void DrawClock(Adafruit_GFX *gfx, tm_t *tm, struct Lunar_Date *Lunar, gui
     GFX_printf(gfx, "年");
 
     GFX_setCursor(gfx, 40, 285);
-    GFX_printf(gfx, " %d周", GetWeekOfYear(tm->tm_year, tm->tm_mon, tm->tm_mday, tm->tm_wday));
+    GFX_printf(gfx, " %d周", iso_week(tm->tm_year + YEAR0, tm->tm_mon + 1, tm->tm_mday));
 
-    uint8_t day = 0;
-    uint8_t JQday = GetJieQiStr(tm->tm_year + YEAR0, tm->tm_mon + 1, tm->tm_mday, &day);
-    if (day == 0) {
-        GFX_setCursor(gfx, data->width - GFX_getUTF8Width(gfx, "小暑") - 50, 275);
+    if (text->jieqi_days == 0) {
+        GFX_setCursor(gfx, data->width - text->jieqi_name - 50, 275);
         GFX_setTextColor(gfx, GFX_RED, GFX_WHITE);
-        GFX_printf(gfx, "%s", JieQiStr[JQday % 24]);
+        GFX_printf(gfx, "%s", JieQiStr[text->jieqi]);
     } else {
-        GFX_setCursor(gfx, data->width - GFX_getUTF8Width(gfx, "离小暑") - 50, 265);
-        GFX_printf(gfx, "离%");
+        GFX_setCursor(gfx, data->width - text->jieqi_name - 50, 265);
+        GFX_printf(gfx, "离");
         GFX_setTextColor(gfx, GFX_RED, GFX_WHITE);
-        GFX_printf(gfx, "%s", JieQiStr[JQday % 24]);
+        GFX_printf(gfx, "%s", JieQiStr[text->jieqi]);
         GFX_setTextColor(gfx, GFX_BLACK, GFX_WHITE);
-        char buf[15] = {0};
-        snprintf(buf, sizeof(buf), "还有%d天", day);
-        GFX_setCursor(gfx, data->width - GFX_getUTF8Width(gfx, buf) - 50, 285);
-        GFX_printf(gfx, buf);
+        GFX_setCursor(gfx, data->width - text->jieqi_left - 50, 285);
+        GFX_printf(gfx, "还有%d天", text->jieqi_days);
     }
 }
 
+static bool TimeSyncNeeded(tm_t *tm)
+{
+    return tm->tm_year + YEAR0 == 2025 && tm->tm_mon + 1 == 1;
+}
+
+static void DrawLayout(Adafruit_GFX *gfx, tm_t *tm, struct Lunar_Date *Lunar, month_info_t *month,
+                       text_layout_t *text, gui_data_t *data, display_mode_t mode)
+{
+    switch (mode) {
+        case MODE_CALENDAR:
+            DrawCalendar(gfx, tm, Lunar, month, text, data);
+            break;
+        case MODE_CLOCK:
+            DrawClock(gfx, tm, Lunar, text, data);
+            break;
+        default:
+            break;
+    }
+    if ((mode == MODE_CALENDAR || mode == MODE_CLOCK) && TimeSyncNeeded(tm)) {
+        DrawTimeSyncTip(gfx, text, data);
+    }
+}
+
+// A saved calendar layer is the display list of DrawCalendarMonth followed by this trailer
+typedef struct {
+    uint32_t key;   // LayerKey of the month it shows
+    int16_t tx;     // returned by DrawCalendarMonth
+    uint16_t len;   // display list words, padded to an even count before the trailer
+} layer_trailer_t;
+
+#define LAYER_TRAILER_WORDS (sizeof(layer_trailer_t) / sizeof(uint16_t))
+#define LAYER_LIST_WORDS(len) (((len) + 1) & ~1)
+
+// Everything the calendar layer depends on. The display list holds font pointers,
+// so a layer saved by another firmware build is not used either.
+static uint32_t LayerKey(tm_t *tm, month_info_t *month, gui_data_t *data)
+{
+    static const char build[] = __DATE__ " " __TIME__;
+    uint16_t v[] = {tm->tm_year, tm->tm_mon, data->week_start, data->color, data->width, data->height,
+                    month->holiday_off, month->holiday_off >> 16, month->holiday_work, month->holiday_work >> 16};
+    uint32_t key = 2166136261u; // FNV-1a
+    for (uint8_t i = 0; i < sizeof(v); i++)
+        key = (key ^ ((uint8_t *)v)[i]) * 16777619u;
+    for (uint8_t i = 0; i < sizeof(build) - 1; i++)
+        key = (key ^ (uint8_t)build[i]) * 16777619u;
+    return key;
+}
+
+static const uint16_t *LoadLayer(const gui_layer_store_t *store, uint32_t key, uint16_t *len, int16_t *tx)
+{
+    uint16_t words = 0;
+    const uint16_t *layer = store->load(&words);
+    if (layer == NULL) return NULL;
+
+    if (words >= LAYER_TRAILER_WORDS && words % 2 == 0) {
+        const layer_trailer_t *trailer = (const layer_trailer_t *)&layer[words - LAYER_TRAILER_WORDS];
+        if (trailer->key == key && LAYER_LIST_WORDS(trailer->len) + LAYER_TRAILER_WORDS == words) {
+            *len = trailer->len;
+            *tx = trailer->tx;
+            return layer;
+        }
+    }
+    store->close();
+    return NULL;
+}
+
+// list has room for size bytes, the trailer goes behind the recorded words
+static void SaveLayer(const gui_layer_store_t *store, uint16_t *list, uint16_t size, uint16_t len,
+                      uint32_t key, int16_t tx)
+{
+    uint16_t words = LAYER_LIST_WORDS(len) + LAYER_TRAILER_WORDS;
+    if (words > size / 2) return;
+
+    layer_trailer_t trailer = {key, tx, len};
+    if (len % 2) list[len] = 0;
+    memcpy(&list[words - LAYER_TRAILER_WORDS], &trailer, sizeof(trailer));
+    store->save(list, words);
+}
+
+static bool BeginGFX(Adafruit_GFX *gfx, gui_data_t *data, uint8_t *pages, uint32_t pages_size)
+{
+    if (data->color == 2)
+      return GFX_begin_3c(gfx, data->width, data->height, pages, pages_size);
+    else if (data->color == 3)
+      return GFX_begin_4c(gfx, data->width, data->height, pages, pages_size);
+    else
+      return GFX_begin(gfx, data->width, data->height, pages, pages_size);
+}
+
 void DrawGUI(gui_data_t *data, buffer_callback draw, display_mode_t mode)
 {
     if (data->week_start > 6) data->week_start = 0;
 
     tm_t tm = {0};
-    struct Lunar_Date Lunar;
 
     transformTime(data->timestamp, &tm);
 
+    // the lookups of the layout are done once, not on every page
+    struct Lunar_Date Lunar;
+    month_info_t month;
+    LUNAR_SolarToLunar(&Lunar, tm.tm_year + YEAR0, tm.tm_mon + 1, tm.tm_mday);
+    if (mode == MODE_CALENDAR)
+        GetMonthInfo(&month, tm.tm_year + YEAR0, tm.tm_mon + 1, data);
+
+    // the display list records at the start of the arena, up to the share it may take
+    uint32_t list_max = data->arena_size / 4 * DISPLAY_LIST_SHARE;
+    uint16_t list_size = (list_max < DISPLAY_LIST_SIZE ? list_max : DISPLAY_LIST_SIZE) & ~3;
+    uint16_t *list = (uint16_t *)data->arena;
+
     Adafruit_GFX gfx;
+    if (!BeginGFX(&gfx, data, data->arena + list_size, data->arena_size - list_size)) {
+        list_size = 0; // not even a row left beside the list
+        if (!BeginGFX(&gfx, data, data->arena, data->arena_size)) return;
+    }
 
-    if (data->color == 2)
-      GFX_begin_3c(&gfx, data->width, data->height, PAGE_HEIGHT);
-    else if (data->color == 3)
-      GFX_begin_4c(&gfx, data->width, data->height, PAGE_HEIGHT);
-    else
-      GFX_begin(&gfx, data->width, data->height, PAGE_HEIGHT);
+    text_layout_t text = {0};
+    GetTextLayout(&gfx, &text, &tm, data, mode);
+
+    // the calendar layer is laid out once a month and saved, other days replay it
+    // and only draw today's parts on top
+    const gui_layer_store_t *store = mode == MODE_CALENDAR ? data->layer_store : NULL;
+    const uint16_t *layer = NULL;
+    uint16_t *new_layer = NULL;
+    uint16_t layer_len = 0;
+    uint32_t layer_key = 0;
+    int16_t tx = 0;
+    if (store != NULL) {
+        layer_key = LayerKey(&tm, &month, data);
+        layer = LoadLayer(store, layer_key, &layer_len, &tx);
+        if (layer == NULL && GFX_beginRecord(&gfx, list, list_size)) {
+            tx = DrawCalendarMonth(&gfx, &tm, &month, &text, data);
+            if (GFX_endRecord(&gfx))
+                layer = new_layer = GFX_detachList(&gfx, &layer_len);
+        }
+    }
+
+    // run the layout once into a display list, every page then replays the part it shows
+    bool recorded = false;
+    if (layer == NULL && GFX_beginRecord(&gfx, list, list_size)) {
+        DrawLayout(&gfx, &tm, &Lunar, &month, &text, data, mode);
+        recorded = GFX_endRecord(&gfx);
+    }
+
+    // the pages take everything the list left, and the whole arena without a list
+    uint32_t list_used = 0;
+    if (new_layer != NULL)
+        list_used = (LAYER_LIST_WORDS(layer_len) + LAYER_TRAILER_WORDS) * sizeof(uint16_t);
+    else if (recorded)
+        list_used = (gfx.dl_len * sizeof(uint16_t) + 3) & ~3;
+    GFX_setBuffer(&gfx, data->arena + list_used, data->arena_size - list_used);
 
     GFX_firstPage(&gfx);
     do {
         GFX_fillScreen(&gfx, GFX_WHITE);
 
-        LUNAR_SolarToLunar(&Lunar, tm.tm_year + YEAR0, tm.tm_mon + 1, tm.tm_mday);
-
-        switch (mode) {
-            case MODE_CALENDAR:
-                DrawCalendar(&gfx, &tm, &Lunar, data);
-                break;
-            case MODE_CLOCK:
-                DrawClock(&gfx, &tm, &Lunar, data);
-                break;
-            default:
-                break;
-        }
-        if ((mode == MODE_CALENDAR || mode == MODE_CLOCK) &&
-            (tm.tm_year + YEAR0 == 2025 && tm.tm_mon + 1 == 1)) {
-            DrawTimeSyncTip(&gfx, data);
-        }
+        if (layer != NULL) {
+            GFX_replayList(&gfx, layer, layer_len);
+            DrawCalendarToday(&gfx, &tm, &Lunar, &month, tx, &text, data);
+            if (TimeSyncNeeded(&tm))
+                DrawTimeSyncTip(&gfx, &text, data);
+        } else if (recorded)
+            GFX_replay(&gfx);
+        else
+            DrawLayout(&gfx, &tm, &Lunar, &month, &text, data, mode);
     } while(GFX_nextPage(&gfx, draw));
 
+    if (new_layer != NULL)
+        SaveLayer(store, new_layer, list_size, layer_len, layer_key, tx);
+    else if (layer != NULL)
+        store->close();
+
     GFX_end(&gfx);
 }
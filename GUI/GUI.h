@@ -3,8 +3,15 @@
 
 #include "Adafruit_GFX.h"
 
-#ifndef PAGE_HEIGHT
-#define PAGE_HEIGHT ((__HEAP_SIZE / 50) - 8)
+// Largest display list (bytes) and the quarters of the render arena it may take. The list
+// records at the start of the arena, the page buffer then gets all the list left over. When
+// the layout does not fit, the arena goes to the page buffer and the layout runs on every page.
+// Past half the arena the extra pages cost more than the replay saves.
+#ifndef DISPLAY_LIST_SIZE
+#define DISPLAY_LIST_SIZE 4096
+#endif
+#ifndef DISPLAY_LIST_SHARE
+#define DISPLAY_LIST_SHARE 2
 #endif
 
 typedef enum {
@@ -13,6 +20,17 @@ typedef enum {
     MODE_CLOCK = 2,
 } display_mode_t;
 
+// Keeps the static calendar layer (title, week bar and month grid) between renders,
+// the calendar then only draws what changes daily on top of it. The layer is the
+// recorded display list with a trailer, replayed page by page instead of a bitmap.
+typedef struct {
+    // returns the saved layer and keeps it readable until close, NULL if there is none
+    const uint16_t *(*load)(uint16_t *words);
+    void (*close)(void);
+    // replaces the saved layer, words is even
+    void (*save)(const uint16_t *data, uint16_t words);
+} gui_layer_store_t;
+
 typedef struct {
     uint16_t color;
     uint16_t width;
@@ -20,8 +38,15 @@ typedef struct {
     uint32_t timestamp;
     uint8_t week_start; // 0: Sunday, 1: Monday
     int8_t temperature;
-    float voltage;
+    uint16_t voltage;   // battery voltage (mV)
+    uint8_t battery;    // remaining capacity (%)
     char ssid[13];
+    uint8_t *arena;      // render memory for the page buffer and the display list, 4-byte aligned
+    uint32_t arena_size; // the page height follows from it
+    const gui_layer_store_t *layer_store; // NULL: no calendar layer cache
+    // holidays (off) and make-up working days (work) of a month, bit d-1 stands for day d,
+    // false if the year is unknown. NULL: only the built-in year is known
+    bool (*holidays)(uint16_t year, uint8_t month, uint32_t *off, uint32_t *work);
 } gui_data_t;
 
 void DrawGUI(gui_data_t *data, buffer_callback draw, display_mode_t mode);
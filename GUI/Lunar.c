@@ -87,14 +87,6 @@ static uint32_t GetBitInt(uint32_t data, uint8_t length, uint8_t shift)
     return (data & (((1 << length) - 1) << shift)) >> shift;
 }
 
-// WARNING: Dates before Oct. 1582 are inaccurate
-static uint16_t SolarToInt(uint16_t y, uint8_t m, uint8_t d)
-{
-    m = (m + 9) % 12;
-    y = y - m / 10;
-    return 365 * y + y / 4 - y / 100 + y / 400 + (m * 306 + 5) / 10 + (d - 1);
-}
-
 void LUNAR_SolarToLunar(struct Lunar_Date *lunar, uint16_t solar_year, uint8_t solar_month, uint8_t solar_date)
 {
     uint8_t i, lunarM, m, d, leap, dm;
@@ -121,7 +113,7 @@ void LUNAR_SolarToLunar(struct Lunar_Date *lunar, uint16_t solar_year, uint8_t s
     y = GetBitInt(solar11, 12, 9);
     m = GetBitInt(solar11, 4, 5);
     d = GetBitInt(solar11, 5, 0);
-    offset = SolarToInt(solar_year, solar_month, solar_date) - SolarToInt(y, m, d);
+    offset = days_from_civil(solar_year, solar_month, solar_date) - days_from_civil(y, m, d);
 
     days = lunar_month_days[year_index];
     leap = GetBitInt(days, 4, 13);
@@ -163,6 +155,49 @@ void LUNAR_SolarToLunar(struct Lunar_Date *lunar, uint16_t solar_year, uint8_t s
     lunar->Year = lunarY;
 }
 
+/* The day after lunar, as LUNAR_SolarToLunar gives it for the next solar day */
+void LUNAR_NextDay(struct Lunar_Date *lunar)
+{
+    uint8_t leap, pos, last;
+    uint32_t days;
+
+    if (lunar->Month == 0)
+        return;
+    if (lunar->Year - solar_1_1[0] >= sizeof(lunar_month_days) / sizeof(uint32_t))
+    {
+        memset(lunar, 0, sizeof(struct Lunar_Date));
+        return;
+    }
+
+    days = lunar_month_days[lunar->Year - solar_1_1[0]];
+    leap = GetBitInt(days, 4, 13);
+
+    /* months in the order of the year, the leap month follows its month */
+    pos = lunar->Month - 1;
+    if (leap != 0 && (lunar->Month > leap || lunar->IsLeap))
+    {
+        pos += 1;
+    }
+    if (lunar->Date < (GetBitInt(days, 1, 12 - pos) == 1 ? 30 : 29))
+    {
+        lunar->Date += 1;
+        return;
+    }
+
+    lunar->Date = 1;
+    last = (leap != 0) ? 12 : 11;
+    if (pos == last)
+    {
+        lunar->Year += 1;
+        lunar->Month = 1;
+        lunar->IsLeap = 0;
+        return;
+    }
+    pos += 1;
+    lunar->IsLeap = (leap != 0 && pos == leap) ? 1 : 0;
+    lunar->Month = (leap != 0 && pos >= leap) ? pos : pos + 1;
+}
+
 uint8_t LUNAR_GetZodiac(const struct Lunar_Date *lunar)
 {
     return lunar->Year % 12;
@@ -409,17 +444,15 @@ uint8_t GetJieQiStr(uint16_t myear, uint8_t mmonth, uint8_t mday, uint8_t *day)
     return JQ;
 }
 
-uint32_t SEC_PER_YR[2] = {31536000, 31622400}; // 闰年和非闰年的秒数
-uint32_t SEC_PER_MT[2][12] = {
-    {2678400, 2419200, 2678400, 2592000, 2678400, 2592000,
-     2678400, 2678400, 2592000, 2678400, 2592000, 2678400},
-    {2678400, 2505600, 2678400, 2592000, 2678400, 2592000,
-     2678400, 2678400, 2592000, 2678400, 2592000, 2678400},
-};
-#define SECOND_OF_DAY 86400 // 一天多少秒
+/*********************************************************************************************************
+ **         以下为公历日期计算相关程序
+ **------------------------------------------------------------------------------------------------------
+ ** 日期与 1970-01-01 起的天数互相换算，整数运算，无需逐年逐月累加。
+ ** http://howardhinnant.github.io/date_algorithms.html
+ ********************************************************************************************************/
 
 /**
- * @Name       : static int is_leap(int yr)
+ * @Name       : int is_leap(int yr)
  * @Description: 判断是否为闰年
  * 				"非整百年份：能被4整除的是闰年。"
  * 				"整百年份：能被400整除的是闰年。"
@@ -435,8 +468,65 @@ int is_leap(int yr)
         return (yr % 4 == 0) ? 1 : 0;
 }
 
+/* days since 1970-01-01, year >= 1970 */
+uint32_t days_from_civil(uint16_t year, uint8_t month, uint8_t day)
+{
+    uint32_t y = year - (month <= 2);
+    uint32_t era = y / 400;
+    uint32_t yoe = y - era * 400;                                       // [0, 399]
+    uint32_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1; // [0, 365], from March 1st
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;               // [0, 146096]
+    return era * 146097 + doe - 719468;
+}
+
+/* the date days after 1970-01-01 */
+void civil_from_days(uint32_t days, uint16_t *year, uint8_t *month, uint8_t *day)
+{
+    uint32_t z = days + 719468;
+    uint32_t era = z / 146097;
+    uint32_t doe = z - era * 146097;                                    // [0, 146096]
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365; // [0, 399]
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);             // [0, 365], from March 1st
+    uint32_t mp = (5 * doy + 2) / 153;                                  // [0, 11], from March
+
+    *day = doy - (153 * mp + 2) / 5 + 1;
+    *month = mp < 10 ? mp + 3 : mp - 9;
+    *year = yoe + era * 400 + (*month <= 2);
+}
+
+/* 0: Sunday, 1970-01-01 was a Thursday */
+uint8_t weekday_from_days(uint32_t days)
+{
+    return (days + 4) % 7;
+}
+
+uint8_t days_in_month(uint16_t year, uint8_t month)
+{
+    if (month == 2)
+        return MonthDayMax[1] + is_leap(year);
+    return MonthDayMax[month - 1];
+}
+
+/* 1 for January 1st */
+uint16_t day_of_year(uint16_t year, uint8_t month, uint8_t day)
+{
+    return days_from_civil(year, month, day) - days_from_civil(year, 1, 1) + 1;
+}
+
+/* ISO 8601 week number, a week belongs to the year its Thursday is in */
+uint8_t iso_week(uint16_t year, uint8_t month, uint8_t day)
+{
+    uint32_t days = days_from_civil(year, month, day);
+    uint32_t thursday = days - (weekday_from_days(days) + 6) % 7 + 3;
+    uint16_t y;
+    uint8_t m, d;
+
+    civil_from_days(thursday, &y, &m, &d);
+    return (thursday - days_from_civil(y, 1, 1)) / 7 + 1;
+}
+
 /**
- * @Name       : static unsigned char day_of_week_get(unsigned char month, unsigned char day,
+ * @Name       : unsigned char day_of_week_get(unsigned char month, unsigned char day,
                                      unsigned short year)
  * @Description: 根据输入的年月日计算当天为星期几
  * @In         : 年、月、日
@@ -446,43 +536,19 @@ int is_leap(int yr)
 unsigned char day_of_week_get(unsigned char month, unsigned char day,
                               unsigned short year)
 {
-    /* Month should be a number 0 to 11, Day should be a number 1 to 31 */
-    static int t[] = {0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4};
-    year -= (uint8_t)(month < 3);
-    return (year + year / 4 - year / 100 + year / 400 + t[month - 1] + day) % 7;
+    /* Month should be a number 1 to 12, Day should be a number 1 to 31 */
+    return weekday_from_days(days_from_civil(year, month, day));
 }
 
 void transformTime(uint32_t unix_time, struct devtm *result)
 {
-    int leapyr = 0;
-    uint32_t ltime = unix_time;
+    uint32_t days = unix_time / SEC_PER_DY;
+    uint32_t ltime = unix_time % SEC_PER_DY;
+    uint8_t month;
 
     memset(result, 0, sizeof(struct devtm));
-    result->tm_year = EPOCH_YR;
-
-    while (1)
-    {
-        if (ltime < SEC_PER_YR[is_leap(result->tm_year)])
-        {
-            break;
-        }
-        ltime -= SEC_PER_YR[is_leap(result->tm_year)];
-        ++(result->tm_year);
-    }
-
-    leapyr = is_leap(result->tm_year);
-
-    while (1)
-    {
-        if (ltime < SEC_PER_MT[leapyr][result->tm_mon])
-            break;
-        ltime -= SEC_PER_MT[leapyr][result->tm_mon];
-        ++(result->tm_mon);
-    }
-
-    result->tm_mday = ltime / SEC_PER_DY;
-    ++(result->tm_mday);
-    ltime = ltime % SEC_PER_DY;
+    civil_from_days(days, &result->tm_year, &month, &result->tm_mday);
+    result->tm_mon = month - 1;
 
     result->tm_hour = ltime / SEC_PER_HR;
     ltime = ltime % SEC_PER_HR;
@@ -490,9 +556,7 @@ void transformTime(uint32_t unix_time, struct devtm *result)
     result->tm_min = ltime / 60;
     result->tm_sec = ltime % 60;
 
-    result->tm_wday =
-        day_of_week_get(result->tm_mon + 1, result->tm_mday,
-                        result->tm_year);
+    result->tm_wday = weekday_from_days(days);
 
     /*
      * The number of years since YEAR0"
@@ -500,18 +564,12 @@ void transformTime(uint32_t unix_time, struct devtm *result)
     result->tm_year -= YEAR0;
 }
 
-uint8_t map[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-
 /*
-获取一个月最后一天值
+获取一个月最后一天值，month 从 0 开始
 */
 uint8_t get_last_day(uint16_t year, uint8_t month)
 {
-    if (month % 12 == 1)
-    {
-        return map[month % 12] + is_leap(year);
-    }
-    return map[month % 12];
+    return days_in_month(year, month % 12 + 1);
 }
 
 /*
@@ -522,29 +580,14 @@ uint8_t get_first_day_week(uint16_t year, uint8_t month)
     return day_of_week_get(month, 1, year);
 }
 
-// 时间结构体转时间戳
+// 时间结构体转时间戳，tm_year 为公历年，tm_mon 从 1 开始
 uint32_t transformTimeStruct(struct devtm *result)
 {
-    uint32_t Cyear = 0;
-    for (uint16_t i = 1970; i < result->tm_year; i++)
-    {
-        if (is_leap(i) == 1)
-            Cyear++;
-    }
-
-    uint32_t CountDay = Cyear * (uint32_t)366 + (uint32_t)(result->tm_year - 1970 - Cyear) * (uint32_t)365 + result->tm_mday - 1;
-    for (uint8_t i = 0; i < result->tm_mon - 1; i++)
-    {
-        CountDay += get_last_day(result->tm_year, i);
-    }
-
-    return (CountDay * SECOND_OF_DAY + (uint32_t)result->tm_sec + (uint32_t)result->tm_min * 60 + (uint32_t)result->tm_hour * 3600);
+    return days_from_civil(result->tm_year, result->tm_mon, result->tm_mday) * SEC_PER_DY +
+           (uint32_t)result->tm_sec + (uint32_t)result->tm_min * 60 + (uint32_t)result->tm_hour * SEC_PER_HR;
 }
 
-uint8_t thisMonthMaxDays(uint8_t year, uint8_t month)
+uint8_t thisMonthMaxDays(uint16_t year, uint8_t month)
 {
-    if (year % 4 == 0 && month == 2)
-        return MonthDayMax[month - 1] + 1;
-    else
-        return MonthDayMax[month - 1];
+    return days_in_month(year, month);
 }
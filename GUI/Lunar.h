@@ -37,17 +37,25 @@ extern const char Lunar_BranchStrig[12][4];
 extern const char JieQiStr[24][7];
 
 void LUNAR_SolarToLunar(struct Lunar_Date *lunar, uint16_t solar_year, uint8_t solar_month, uint8_t solar_date);
+void LUNAR_NextDay(struct Lunar_Date *lunar);
 uint8_t LUNAR_GetZodiac(const struct Lunar_Date *lunar);
 uint8_t LUNAR_GetStem(const struct Lunar_Date *lunar);
 uint8_t LUNAR_GetBranch(const struct Lunar_Date *lunar);
 uint8_t GetJieQiStr(uint16_t myear, uint8_t mmonth, uint8_t mday, uint8_t *day);
 uint8_t GetJieQi(uint16_t myear, uint8_t mmonth, uint8_t mday, uint8_t *JQdate);
 
+uint32_t days_from_civil(uint16_t year, uint8_t month, uint8_t day);
+void civil_from_days(uint32_t days, uint16_t *year, uint8_t *month, uint8_t *day);
+uint8_t weekday_from_days(uint32_t days);
+uint8_t days_in_month(uint16_t year, uint8_t month);
+uint16_t day_of_year(uint16_t year, uint8_t month, uint8_t day);
+uint8_t iso_week(uint16_t year, uint8_t month, uint8_t day);
+
 void transformTime(uint32_t unix_time, struct devtm *result);
 uint32_t transformTimeStruct(struct devtm *result);
 uint8_t get_first_day_week(uint16_t year, uint8_t month);
 uint8_t get_last_day(uint16_t year, uint8_t month);
 unsigned char day_of_week_get(unsigned char month, unsigned char day, unsigned short year);
-uint8_t thisMonthMaxDays(uint8_t year, uint8_t month);
+uint8_t thisMonthMaxDays(uint16_t year, uint8_t month);
 
 #endif
@@ -201,3 +201,119 @@ const uint8_t u8g2_font_helvB18_tn[389] U8G2_FONT_SECTION("u8g2_font_helvB18_tn"
   "\14\215\14\315\214LY\35\304\14M\214y\66\61\64r\60d\3\71\37,\11\373\30\35\310\220P\20M"
   "\214yvDARq@S\61\71i\65ARr U\4:\12\343\14/\34\310C\36\10\0\0\0"
   "\4\377\377\0";
+
+/* BEGIN font index, generated by tools/font_index.py, do not edit */
+
+static const uint16_t u8g2_font_wqy9_t_lunar_encoding[228] = {
+  32,33,34,35,36,37,38,39,40,41,42,43,44,45,46,47,
+  48,49,50,51,52,53,54,55,56,57,58,59,60,61,62,63,
+  64,65,66,67,68,69,70,71,72,73,74,75,76,77,78,79,
+  80,81,82,83,84,85,86,87,88,89,90,91,92,93,94,95,
+  96,97,98,99,100,101,102,103,104,105,106,107,108,109,110,111,
+  112,113,114,115,116,117,118,119,120,121,122,123,124,125,126,128,
+  8451,19968,19969,19971,19975,19977,19985,19993,20013,20057,20061,20108,20116,20133,20146,20154,
+  20241,20799,20803,20820,20826,20843,20845,20891,20908,20998,21021,21160,21171,21313,21320,21359,
+  21608,22235,22269,22307,22764,22788,22799,22805,22812,22823,22825,22836,22899,22919,23376,23433,
+  23477,23493,23506,23567,24050,24051,24072,24179,24180,24198,24218,24314,24319,24681,24773,24778,
+  24858,24863,25098,25100,25260,25945,26085,26086,26126,26143,26149,26257,26376,26377,26399,26410,
+  26641,26893,27491,27597,27700,28165,28385,29238,29275,29399,29482,29492,29677,30002,30003,30328,
+  30333,31163,31179,31181,31435,31461,31471,32650,33098,33267,33410,33426,34382,34503,34544,34915,
+  35806,35895,36763,36784,36824,37193,37325,38384,38451,38477,38500,38632,38634,38684,38706,38738,
+  39532,40481,40736,40857,
+};
+static const uint16_t u8g2_font_wqy9_t_lunar_offset[228] = {
+  25,30,37,44,58,73,89,103,109,120,132,144,155,162,168,174,
+  186,196,205,216,228,242,255,268,279,292,305,311,320,328,336,345,
+  358,378,392,405,417,430,440,451,464,475,483,491,504,513,529,542,
+  554,566,580,596,608,617,627,642,659,672,683,693,702,714,723,731,
+  737,744,756,768,776,787,798,807,819,830,837,845,858,865,879,888,
+  898,910,921,929,941,951,960,972,986,997,1010,1020,1031,1038,1049,1056,
+  1078,1101,1111,1132,1154,1175,1190,1213,1239,1261,1285,1308,1320,1342,1365,1388,
+  1411,1436,1459,1480,1506,1532,1556,1576,1600,1624,1648,1675,1703,1727,1750,1773,
+  1800,1829,1853,1878,1902,1926,1952,1977,2002,2031,2055,2079,2104,2127,2156,2180,
+  2204,2230,2255,2282,2306,2328,2352,2383,2407,2430,2455,2482,2510,2534,2560,2590,
+  2620,2649,2680,2705,2732,2761,2789,2802,2825,2850,2877,2903,2930,2955,2979,3011,
+  3034,3063,3093,3119,3146,3170,3200,3232,3258,3281,3310,3342,3374,3403,3425,3447,
+  3473,3489,3516,3545,3572,3596,3620,3651,3674,3709,3732,3754,3778,3806,3832,3862,
+  3887,3918,3944,3967,3995,4022,4049,4073,4100,4130,4160,4190,4214,4239,4268,4298,
+  4322,4346,4375,4405,
+};
+static const u8g2_glyph_metrics_t u8g2_font_wqy9_t_lunar_metrics[228] = {
+  {6,0,0},{6,1,2},{6,4,1},{7,6,0},{6,5,0},{6,6,0},{6,5,0},{5,1,2},
+  {6,3,1},{6,3,1},{6,5,0},{8,7,0},{6,2,2},{6,5,0},{5,1,2},{6,4,0},
+  {6,5,0},{6,5,0},{6,5,0},{6,5,0},{7,6,0},{6,5,0},{6,5,0},{6,5,0},
+  {6,5,0},{6,5,0},{2,1,0},{6,2,2},{6,5,0},{6,5,0},{6,5,0},{6,5,0},
+  {8,7,0},{8,7,0},{7,6,0},{7,6,0},{8,7,0},{6,5,0},{6,5,0},{7,6,0},
+  {7,6,0},{4,3,0},{4,3,0},{6,5,0},{6,5,0},{8,7,0},{7,6,0},{8,7,0},
+  {6,5,0},{8,7,0},{7,6,0},{6,5,0},{8,7,0},{7,6,0},{8,7,0},{10,9,0},
+  {7,6,0},{8,7,0},{8,7,0},{6,3,2},{6,5,0},{6,3,1},{6,5,0},{6,5,0},
+  {5,2,1},{6,5,0},{6,5,0},{5,4,0},{6,5,0},{6,5,0},{4,3,0},{6,5,0},
+  {6,5,0},{2,1,0},{3,2,0},{6,5,0},{2,1,0},{8,7,0},{6,5,0},{6,5,0},
+  {6,5,0},{6,5,0},{4,3,0},{6,5,0},{4,3,0},{6,5,0},{6,5,0},{8,7,0},
+  {6,5,0},{6,5,0},{6,5,0},{4,3,0},{5,1,2},{4,3,0},{7,6,0},{6,5,0},
+  {12,10,0},{12,11,0},{12,10,1},{12,10,1},{12,11,0},{12,11,0},{12,11,0},{12,11,0},
+  {12,9,1},{12,10,1},{12,10,1},{12,11,0},{12,11,0},{12,10,1},{12,11,0},{12,11,0},
+  {12,11,0},{12,11,0},{12,10,1},{12,11,0},{12,10,1},{12,11,0},{12,11,0},{12,10,1},
+  {12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,10,1},{12,11,0},{12,10,1},{12,10,1},
+  {12,11,0},{12,9,1},{12,10,1},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},
+  {12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},
+  {12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,10,1},{12,10,1},{12,11,0},{12,11,0},
+  {12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},
+  {12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,7,2},{12,11,0},
+  {12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,9,1},{12,11,0},{12,11,0},{12,11,0},
+  {12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},
+  {12,10,1},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,9,1},{12,9,1},{12,11,0},
+  {12,8,2},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},
+  {12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},
+  {12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},
+  {12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},{12,11,0},
+  {12,11,0},{12,11,0},{12,10,1},{12,11,0},
+};
+
+static const uint16_t u8g2_font_wqy12_t_lunar_encoding[13] = {
+  48,49,50,51,52,53,54,55,56,57,24180,26085,26376,
+};
+static const uint16_t u8g2_font_wqy12_t_lunar_offset[13] = {
+  25,39,49,63,80,99,115,133,147,166,191,220,237,
+};
+static const u8g2_glyph_metrics_t u8g2_font_wqy12_t_lunar_metrics[13] = {
+  {8,7,1},{8,5,3},{8,7,1},{8,7,1},{9,8,1},{8,7,1},{8,7,1},{8,7,1},
+  {8,7,1},{8,7,1},{16,15,0},{16,9,3},{16,12,2},
+};
+
+static const uint16_t u8g2_font_helvB14_tn_encoding[18] = {
+  32,42,43,44,45,46,47,48,49,50,51,52,53,54,55,56,
+  57,58,
+};
+static const uint16_t u8g2_font_helvB14_tn_offset[18] = {
+  25,30,45,57,66,73,80,95,110,120,137,156,177,198,218,234,
+  252,272,
+};
+static const u8g2_glyph_metrics_t u8g2_font_helvB14_tn_metrics[18] = {
+  {5,0,0},{9,7,1},{11,8,1},{5,3,1},{6,5,0},{5,3,1},{5,5,0},{10,9,0},
+  {10,6,1},{10,9,0},{10,9,0},{10,9,0},{10,9,0},{10,9,0},{10,9,0},{10,9,0},
+  {10,9,0},{6,3,1},
+};
+
+static const uint16_t u8g2_font_helvB18_tn_encoding[18] = {
+  32,42,43,44,45,46,47,48,49,50,51,52,53,54,55,56,
+  57,58,
+};
+static const uint16_t u8g2_font_helvB18_tn_offset[18] = {
+  25,30,45,59,69,75,82,100,127,139,166,196,223,252,284,308,
+  342,373,
+};
+static const u8g2_glyph_metrics_t u8g2_font_helvB18_tn_metrics[18] = {
+  {6,0,0},{10,8,1},{15,12,1},{7,3,2},{8,7,0},{7,3,2},{8,7,1},{13,12,0},
+  {13,7,2},{13,12,0},{13,12,0},{13,12,0},{13,12,0},{13,12,0},{13,12,0},{13,12,0},
+  {13,12,0},{7,3,2},
+};
+
+const u8g2_font_index_t u8g2_font_index[] = {
+  {u8g2_font_wqy9_t_lunar, u8g2_font_wqy9_t_lunar_encoding, u8g2_font_wqy9_t_lunar_offset, u8g2_font_wqy9_t_lunar_metrics, 228},
+  {u8g2_font_wqy12_t_lunar, u8g2_font_wqy12_t_lunar_encoding, u8g2_font_wqy12_t_lunar_offset, u8g2_font_wqy12_t_lunar_metrics, 13},
+  {u8g2_font_helvB14_tn, u8g2_font_helvB14_tn_encoding, u8g2_font_helvB14_tn_offset, u8g2_font_helvB14_tn_metrics, 18},
+  {u8g2_font_helvB18_tn, u8g2_font_helvB18_tn_encoding, u8g2_font_helvB18_tn_offset, u8g2_font_helvB18_tn_metrics, 18},
+  {NULL, NULL, NULL, NULL, 0},
+};
+/* END font index */
@@ -36,8 +36,28 @@
 */
 
 #include <stddef.h>
+#include <string.h>
 #include "u8g2_font.h"
 
+#if U8G2_GLYPH_CACHE_ENTRIES > 0
+/* decoded glyph, the bitmap has 1 bit per pixel, rows padded to whole bytes, MSB first */
+typedef struct
+{
+    const uint8_t *font;        /* NULL for a free entry */
+    uint16_t encoding;
+    uint16_t used;              /* LRU stamp */
+    int8_t x, y, d;             /* glyph offset and delta x */
+    uint8_t w, h;
+    uint8_t bitmap[U8G2_GLYPH_CACHE_BITMAP];
+} u8g2_glyph_cache_t;
+
+static u8g2_glyph_cache_t u8g2_glyph_cache[U8G2_GLYPH_CACHE_ENTRIES];
+static uint16_t u8g2_glyph_cache_clock;
+static u8g2_glyph_cache_t *u8g2_glyph_cache_fill;   /* entry the decoder also writes to, or NULL */
+#endif
+static uint32_t u8g2_glyph_cache_hits;
+static uint32_t u8g2_glyph_cache_misses;
+
 static uint8_t u8g2_font_get_byte(const uint8_t *font, uint8_t offset)
 {
     font += offset;
@@ -118,33 +138,25 @@ uint8_t u8g2_GetFontCapitalAHeight(u8g2_font_t *u8g2)
     return u8g2->font_info.ascent_A;    /* new font info structure */
 }
 
-static uint8_t u8g2_font_decode_get_unsigned_bits(u8g2_font_decode_t *f, uint8_t cnt) U8X8_NOINLINE;
-static uint8_t u8g2_font_decode_get_unsigned_bits(u8g2_font_decode_t *f, uint8_t cnt) 
+/* cnt is at most 8. The bits are kept in a 32 bit word which is refilled up to */
+/* 4 bytes at once, so most fields are a shift and a mask. The refill stops at */
+/* the end of the glyph, the font array has no padding after the last glyph. */
+static inline uint8_t u8g2_font_decode_get_unsigned_bits(u8g2_font_decode_t *f, uint8_t cnt)
 {
     uint8_t val;
-    uint8_t bit_pos = f->decode_bit_pos;
-    uint8_t bit_pos_plus_cnt;
-    
-    //val = *(f->decode_ptr);
-    val = u8x8_pgm_read( f->decode_ptr );  
-    
-    val >>= bit_pos;
-    bit_pos_plus_cnt = bit_pos;
-    bit_pos_plus_cnt += cnt;
-    if ( bit_pos_plus_cnt >= 8 )
+
+    if ( f->decode_bit_cnt < cnt )
     {
-        uint8_t s = 8;
-        s -= bit_pos;
-        f->decode_ptr++;
-        //val |= *(f->decode_ptr) << (8-bit_pos);
-        val |= u8x8_pgm_read( f->decode_ptr ) << (s);
-        //bit_pos -= 8;
-        bit_pos_plus_cnt -= 8;
+        do
+        {
+            f->decode_bits |= (uint32_t)u8x8_pgm_read( f->decode_ptr ) << f->decode_bit_cnt;
+            f->decode_ptr++;
+            f->decode_bit_cnt += 8;
+        } while ( f->decode_bit_cnt <= 24 && f->decode_ptr < f->decode_end );
     }
-    val &= (1U<<cnt)-1;
-    //bit_pos += cnt;
-    
-    f->decode_bit_pos = bit_pos_plus_cnt;
+    val = f->decode_bits & ((1U<<cnt)-1);
+    f->decode_bits >>= cnt;
+    f->decode_bit_cnt -= cnt;
     return val;
 }
 
@@ -220,6 +232,22 @@ static int16_t u8g2_add_vector_x(int16_t dx, int8_t x, int8_t y, uint8_t dir)
     return dx;
 }
 
+/* true if the w x h box of a glyph, x, y being its offset as in the font, */
+/* can not touch the clip box when drawn at the target position */
+static uint8_t u8g2_font_glyph_clipped(u8g2_font_t *u8g2, int8_t x, int8_t y, uint8_t w, uint8_t h)
+{
+    u8g2_font_decode_t *decode = &(u8g2->font_decode);
+    int8_t top = -(h + y);
+    int16_t x0 = u8g2_add_vector_x(decode->target_x, x, top, decode->dir);
+    int16_t y0 = u8g2_add_vector_y(decode->target_y, x, top, decode->dir);
+    int16_t x1 = u8g2_add_vector_x(decode->target_x, x + w - 1, top + h - 1, decode->dir);
+    int16_t y1 = u8g2_add_vector_y(decode->target_y, x + w - 1, top + h - 1, decode->dir);
+
+    if ( x0 > x1 ) { int16_t t = x0; x0 = x1; x1 = t; }
+    if ( y0 > y1 ) { int16_t t = y0; y0 = y1; y1 = t; }
+    return x1 < u8g2->clip_x0 || x0 > u8g2->clip_x1 || y1 < u8g2->clip_y0 || y0 > u8g2->clip_y1;
+}
+
 /*
     Description:
         Draw a run-length area of the glyph. "len" can have any size and the line
@@ -286,6 +314,15 @@ static void u8g2_font_decode_len(u8g2_font_t *u8g2, uint8_t len, uint8_t is_fore
         /* draw foreground and background (if required) */
         if ( current > 0 )    /* avoid drawing zero length lines, issue #4 */
         {
+#if U8G2_GLYPH_CACHE_ENTRIES > 0
+            /* the bitmap is cleared, only the foreground is set */
+            if ( u8g2_glyph_cache_fill != NULL && is_foreground )
+            {
+                uint8_t *row = u8g2_glyph_cache_fill->bitmap + ly * ((decode->glyph_width + 7) / 8);
+                for ( uint8_t i = lx; i < lx + current; i++ )
+                    row[i >> 3] |= 0x80 >> (i & 7);
+            }
+#endif
             if ( is_foreground )
             {
                 u8g2->draw_hv_line(u8g2, x, y, current, decode->dir, decode->fg_color);
@@ -310,11 +347,14 @@ static void u8g2_font_decode_len(u8g2_font_t *u8g2, uint8_t len, uint8_t is_fore
     
 }
 
-static void u8g2_font_setup_decode(u8g2_font_t *u8g2, const uint8_t *glyph_data)
+static void u8g2_font_setup_decode(u8g2_font_t *u8g2, const uint8_t *glyph_data, uint16_t encoding)
 {
     u8g2_font_decode_t *decode = &(u8g2->font_decode);
     decode->decode_ptr = glyph_data;
-    decode->decode_bit_pos = 0;
+    /* the glyph size byte precedes the data and counts the 2 (ascii) or 3 (unicode) header bytes */
+    decode->decode_end = glyph_data + u8x8_pgm_read( glyph_data - 1 ) - ( encoding <= 255 ? 2 : 3 );
+    decode->decode_bits = 0;
+    decode->decode_bit_cnt = 0;
     
     /* 8 Nov 2015, this is already done in the glyph data search procedure */
     /*
@@ -330,34 +370,23 @@ static void u8g2_font_setup_decode(u8g2_font_t *u8g2, const uint8_t *glyph_data)
 
 /*
     Description:
-        Decode and draw a glyph.
+        Decode and draw a glyph, the header has already been read.
     Args:
-        glyph_data:           Pointer to the compressed glyph data of the font
-        u8g2->font_decode.target_x    X position
-        u8g2->font_decode.target_y    Y position
+        x, y:                 Offset of the glyph from its header
+        u8g2->font_decode     Positioned behind the header, target_x/y set to the glyph position
         u8g2->font_decode.is_transparent  Transparent mode
-    Return:
-        Width (delta x advance) of the glyph.
     Calls:
         u8g2_font_decode_len()
 */
 /* optimized */
-static int8_t u8g2_font_decode_glyph(u8g2_font_t *u8g2, const uint8_t *glyph_data)
+static void u8g2_font_decode_glyph(u8g2_font_t *u8g2, int8_t x, int8_t y)
 {
     uint8_t a, b;
-    int8_t x, y;
-    int8_t d;
     int8_t h;
     u8g2_font_decode_t *decode = &(u8g2->font_decode);
         
-    u8g2_font_setup_decode(u8g2, glyph_data);
     h = u8g2->font_decode.glyph_height;
     
-    x = u8g2_font_decode_get_signed_bits(decode, u8g2->font_info.bits_per_char_x);
-    y = u8g2_font_decode_get_signed_bits(decode, u8g2->font_info.bits_per_char_y);
-    d = u8g2_font_decode_get_signed_bits(decode, u8g2->font_info.bits_per_delta_x);
-
-    
     if ( decode->glyph_width > 0 )
     {
         decode->target_x = u8g2_add_vector_x(decode->target_x, x, -(h+y), decode->dir);
@@ -385,9 +414,93 @@ static int8_t u8g2_font_decode_glyph(u8g2_font_t *u8g2, const uint8_t *glyph_dat
         }
         
     }
-    return d;
 }
 
+#if U8G2_GLYPH_CACHE_ENTRIES > 0
+static u8g2_glyph_cache_t *u8g2_glyph_cache_find(const uint8_t *font, uint16_t encoding)
+{
+    for ( uint16_t i = 0; i < U8G2_GLYPH_CACHE_ENTRIES; i++ )
+    {
+        u8g2_glyph_cache_t *entry = &u8g2_glyph_cache[i];
+        if ( entry->encoding == encoding && entry->font == font )
+        {
+            entry->used = ++u8g2_glyph_cache_clock;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/* take the least recently used entry for a glyph whose header has been read, */
+/* NULL if it does not fit, the bitmap is filled while the glyph is decoded */
+static u8g2_glyph_cache_t *u8g2_glyph_cache_add(u8g2_font_t *u8g2, uint16_t encoding, int8_t x, int8_t y, int8_t d)
+{
+    u8g2_font_decode_t *decode = &(u8g2->font_decode);
+    u8g2_glyph_cache_t *entry = &u8g2_glyph_cache[0];
+
+    if ( ((decode->glyph_width + 7) / 8) * decode->glyph_height > U8G2_GLYPH_CACHE_BITMAP )
+        return NULL;
+
+    for ( uint16_t i = 1; i < U8G2_GLYPH_CACHE_ENTRIES && entry->font != NULL; i++ )
+    {
+        u8g2_glyph_cache_t *e = &u8g2_glyph_cache[i];
+        if ( e->font == NULL || (uint16_t)(u8g2_glyph_cache_clock - e->used) > (uint16_t)(u8g2_glyph_cache_clock - entry->used) )
+            entry = e;
+    }
+
+    entry->font = u8g2->font;
+    entry->encoding = encoding;
+    entry->used = ++u8g2_glyph_cache_clock;
+    entry->w = decode->glyph_width;
+    entry->h = decode->glyph_height;
+    entry->x = x;
+    entry->y = y;
+    entry->d = d;
+    memset(entry->bitmap, 0, sizeof(entry->bitmap));
+    return entry;
+}
+
+/* draw a cached glyph as horizontal runs, uniform bytes are skipped as a whole */
+static int8_t u8g2_glyph_cache_draw(u8g2_font_t *u8g2, const u8g2_glyph_cache_t *entry)
+{
+    u8g2_font_decode_t *decode = &(u8g2->font_decode);
+    uint8_t stride = (entry->w + 7) / 8;
+
+    if ( entry->w == 0 || u8g2_font_glyph_clipped(u8g2, entry->x, entry->y, entry->w, entry->h) )
+        return entry->d;
+
+    decode->target_x = u8g2_add_vector_x(decode->target_x, entry->x, -(entry->h + entry->y), decode->dir);
+    decode->target_y = u8g2_add_vector_y(decode->target_y, entry->x, -(entry->h + entry->y), decode->dir);
+
+    for ( uint8_t ly = 0; ly < entry->h; ly++ )
+    {
+        const uint8_t *row = entry->bitmap + ly * stride;
+        uint8_t lx = 0;
+        while ( lx < entry->w )
+        {
+            uint8_t start = lx;
+            uint8_t is_foreground = (row[lx >> 3] >> (7 - (lx & 7))) & 1;
+            uint8_t same = is_foreground ? 0xFF : 0x00;
+            do
+            {
+                lx++;
+                if ( (lx & 7) == 0 )
+                    while ( lx + 8 <= entry->w && row[lx >> 3] == same )
+                        lx += 8;
+            } while ( lx < entry->w && ((row[lx >> 3] >> (7 - (lx & 7))) & 1) == is_foreground );
+
+            int16_t x = u8g2_add_vector_x(decode->target_x, start, ly, decode->dir);
+            int16_t y = u8g2_add_vector_y(decode->target_y, start, ly, decode->dir);
+            if ( is_foreground )
+                u8g2->draw_hv_line(u8g2, x, y, lx - start, decode->dir, decode->fg_color);
+            else if ( decode->is_transparent == 0 )
+                u8g2->draw_hv_line(u8g2, x, y, lx - start, decode->dir, decode->bg_color);
+        }
+    }
+    return entry->d;
+}
+#endif
+
 /*
     Description:
         Find the starting point of the glyph data.
@@ -396,9 +509,36 @@ static int8_t u8g2_font_decode_glyph(u8g2_font_t *u8g2, const uint8_t *glyph_dat
     Return:
         Address of the glyph data or NULL, if the encoding is not avialable in the font.
 */
+/* binary search in the generated index, returns glyph_cnt if the encoding is not in the font */
+static uint16_t u8g2_font_index_find(const u8g2_font_index_t *index, uint16_t encoding)
+{
+    const uint16_t *encodings = index->encoding;
+    uint16_t lo = 0, hi = index->glyph_cnt;
+    while ( lo < hi )
+    {
+        uint16_t mid = (lo + hi) / 2;
+        if ( encodings[mid] < encoding )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if ( lo < index->glyph_cnt && encodings[lo] == encoding )
+        return lo;
+    return index->glyph_cnt;
+}
+
 const uint8_t *u8g2_font_get_glyph_data(u8g2_font_t *u8g2, uint16_t encoding)
 {
     const uint8_t *font = u8g2->font;
+
+    if ( u8g2->index != NULL )
+    {
+        uint16_t i = u8g2_font_index_find(u8g2->index, encoding);
+        if ( i < u8g2->index->glyph_cnt )
+            return font + u8g2->index->offset[i];
+        return NULL;
+    }
+
     font += 23;
 
     
@@ -467,14 +607,46 @@ static int16_t u8g2_font_draw_glyph(u8g2_font_t *u8g2, int16_t x, int16_t y, uin
     u8g2->font_decode.target_y = y;
     //u8g2->font_decode.is_transparent = is_transparent; this is already set
     //u8g2->font_decode.dir = dir;
+#if U8G2_GLYPH_CACHE_ENTRIES > 0
+    u8g2_glyph_cache_t *entry = u8g2_glyph_cache_find(u8g2->font, encoding);
+    if ( entry != NULL )
+    {
+        u8g2_glyph_cache_hits++;
+        return u8g2_glyph_cache_draw(u8g2, entry);
+    }
+#endif
     const uint8_t *glyph_data = u8g2_font_get_glyph_data(u8g2, encoding);
     if ( glyph_data != NULL )
     {
-        dx = u8g2_font_decode_glyph(u8g2, glyph_data);
+        /* a glyph outside of the clip box only needs its advance, it is neither */
+        /* decoded nor cached */
+        u8g2_font_decode_t *decode = &(u8g2->font_decode);
+        u8g2_font_setup_decode(u8g2, glyph_data, encoding);
+        int8_t x = u8g2_font_decode_get_signed_bits(decode, u8g2->font_info.bits_per_char_x);
+        int8_t y = u8g2_font_decode_get_signed_bits(decode, u8g2->font_info.bits_per_char_y);
+        dx = u8g2_font_decode_get_signed_bits(decode, u8g2->font_info.bits_per_delta_x);
+        if ( decode->glyph_width == 0 ||
+             u8g2_font_glyph_clipped(u8g2, x, y, decode->glyph_width, decode->glyph_height) )
+            return dx;
+
+        u8g2_glyph_cache_misses++;
+#if U8G2_GLYPH_CACHE_ENTRIES > 0
+        u8g2_glyph_cache_fill = u8g2_glyph_cache_add(u8g2, encoding, x, y, dx);
+#endif
+        u8g2_font_decode_glyph(u8g2, x, y);
+#if U8G2_GLYPH_CACHE_ENTRIES > 0
+        u8g2_glyph_cache_fill = NULL;
+#endif
     }
     return dx;
 }
 
+void u8g2_GetGlyphCacheStats(uint32_t *hits, uint32_t *misses)
+{
+    *hits = u8g2_glyph_cache_hits;
+    *misses = u8g2_glyph_cache_misses;
+}
+
 
 //========================================================
 
@@ -490,11 +662,23 @@ uint8_t u8g2_IsGlyph(u8g2_font_t *u8g2, uint16_t requested_encoding)
 /* actually u8g2_GetGlyphWidth returns the glyph delta x and glyph width itself is set as side effect */
 int8_t u8g2_GetGlyphWidth(u8g2_font_t *u8g2, uint16_t requested_encoding)
 {
+    if ( u8g2->index != NULL )
+    {
+        /* indexed fonts come with the metrics, no need to decode the glyph header */
+        uint16_t i = u8g2_font_index_find(u8g2->index, requested_encoding);
+        if ( i >= u8g2->index->glyph_cnt )
+            return 0;
+        const u8g2_glyph_metrics_t *m = &u8g2->index->metrics[i];
+        u8g2->font_decode.glyph_width = m->width;
+        u8g2->glyph_x_offset = m->x_offset;
+        return m->delta_x;
+    }
+
     const uint8_t *glyph_data = u8g2_font_get_glyph_data(u8g2, requested_encoding);
     if ( glyph_data == NULL )
         return 0; 
     
-    u8g2_font_setup_decode(u8g2, glyph_data);
+    u8g2_font_setup_decode(u8g2, glyph_data, requested_encoding);
     u8g2->glyph_x_offset = u8g2_font_decode_get_signed_bits(&(u8g2->font_decode), u8g2->font_info.bits_per_char_x);
     u8g2_font_decode_get_signed_bits(&(u8g2->font_decode), u8g2->font_info.bits_per_char_y);
     
@@ -557,6 +741,16 @@ void u8g2_SetFont(u8g2_font_t *u8g2, const uint8_t  *font)
     {
         u8g2->font = font;
         u8g2->font_decode.is_transparent = 0; 
+
+        u8g2->index = NULL;
+        for ( const u8g2_font_index_t *index = u8g2_font_index; index->font != NULL; index++ )
+        {
+            if ( index->font == font )
+            {
+                u8g2->index = index;
+                break;
+            }
+        }
         
         u8g2_read_font_info(&(u8g2->font_info), font);
     }
@@ -37,6 +37,7 @@
 #ifndef __U8G2_H
 #define __U8G2_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __GNUC__
@@ -77,6 +78,21 @@
 #endif 
 #endif
 
+/* Decoded glyph cache, glyphs drawn again are blitted from RAM instead of */
+/* being decoded from the font. 0 entries disables it. */
+#ifndef U8G2_GLYPH_CACHE_ENTRIES
+#if defined(S130)
+#define U8G2_GLYPH_CACHE_ENTRIES 0      /* nRF51 has no RAM to spare */
+#else
+#define U8G2_GLYPH_CACHE_ENTRIES 16
+#endif
+#endif
+
+/* bitmap bytes per entry, larger glyphs are always decoded */
+#ifndef U8G2_GLYPH_CACHE_BITMAP
+#define U8G2_GLYPH_CACHE_BITMAP 40
+#endif
+
 typedef struct _u8g2_font_info_t
 {
     /* offset 0 */
@@ -112,9 +128,32 @@ typedef struct _u8g2_font_info_t
     uint16_t start_pos_unicode;
 } u8g2_font_info_t;
 
+/* glyph header fields needed to measure text */
+typedef struct _u8g2_glyph_metrics_t
+{
+    int8_t delta_x;             /* advance */
+    int8_t width;
+    int8_t x_offset;
+} u8g2_glyph_metrics_t;
+
+/* glyph lookup index of a font, generated into fonts.c by tools/font_index.py */
+typedef struct _u8g2_font_index_t
+{
+    const uint8_t *font;
+    const uint16_t *encoding;   /* sorted */
+    const uint16_t *offset;     /* offset of the glyph data in the font */
+    const u8g2_glyph_metrics_t *metrics;
+    uint16_t glyph_cnt;
+} u8g2_font_index_t;
+
+/* indexed fonts, terminated by a NULL font */
+extern const u8g2_font_index_t u8g2_font_index[];
+
 typedef struct _u8g2_font_decode_t
 {
-    const uint8_t *decode_ptr;      /* pointer to the compressed data */
+    const uint8_t *decode_ptr;      /* next byte of the compressed data to be read */
+    const uint8_t *decode_end;      /* end of the glyph data, nothing is read from here on */
+    uint32_t decode_bits;           /* bits read ahead, the next one is bit 0 */
     
     int16_t target_x;
     int16_t target_y;
@@ -126,7 +165,7 @@ typedef struct _u8g2_font_decode_t
     int8_t glyph_width; 
     int8_t glyph_height;
 
-    uint8_t decode_bit_pos;     /* bitpos inside a byte of the compressed data */
+    uint8_t decode_bit_cnt;     /* number of bits in decode_bits */
     uint8_t is_transparent;
     uint8_t dir;        /* direction */
 } u8g2_font_decode_t;
@@ -134,12 +173,16 @@ typedef struct _u8g2_font_decode_t
 typedef struct _u8g2_font_t
 {
     const uint8_t *font;             /* current font for all text procedures */
+    const u8g2_font_index_t *index;  /* glyph index of the font, NULL to scan the glyphs */
 
     u8g2_font_decode_t font_decode;  /* new font decode structure */
     u8g2_font_info_t font_info;      /* new font info structure */
 
     int8_t glyph_x_offset;           /* set by u8g2_GetGlyphWidth as a side effect */
 
+    int16_t clip_x0, clip_y0;        /* glyphs entirely outside of this box are skipped */
+    int16_t clip_x1, clip_y1;        /* without being decoded, inclusive */
+
     void (*draw_hv_line)(struct _u8g2_font_t *u8g2, int16_t x, int16_t y,
                          int16_t len, uint8_t dir, uint16_t color);
 } u8g2_font_t;
@@ -153,5 +196,6 @@ int16_t u8g2_DrawStr(u8g2_font_t *u8g2, int16_t x, int16_t y, const char *s);
 void u8g2_SetFont(u8g2_font_t *u8g2, const uint8_t  *font);
 void u8g2_SetForegroundColor(u8g2_font_t *u8g2, uint16_t fg);
 void u8g2_SetBackgroundColor(u8g2_font_t *u8g2, uint16_t bg);
+void u8g2_GetGlyphCacheStats(uint32_t *hits, uint32_t *misses);
 
 #endif
@@ -6,11 +6,14 @@
 #include <string.h>
 #include <wchar.h>
 #include "GUI.h"
+#include "EPD_energy.h"
 
 #define BITMAP_WIDTH   400
 #define BITMAP_HEIGHT  300
 #define WINDOW_WIDTH   450
 #define WINDOW_HEIGHT  380
+#define REFRESH_MS_BW  3000   // typical panel busy time of a full refresh
+#define REFRESH_MS_BWR 15000
 
 // Global variables
 HINSTANCE g_hInstance;
@@ -21,6 +24,9 @@ BOOL g_bwr_mode = TRUE;  // Default to BWR mode
 uint8_t g_week_start = 0; // Default week start (0=Sunday, 1=Monday, etc.)
 time_t g_display_time;
 struct tm g_tm_time;
+energy_counters_t g_energy;
+// render arena: display list plus a whole 3-color frame, drawn in one page
+uint32_t g_arena[(DISPLAY_LIST_SIZE + 2 * (BITMAP_WIDTH / 8) * BITMAP_HEIGHT) / 4];
 
 // Implementation of the buffer_callback function
 void DrawBitmap(uint8_t *black, uint8_t *color, uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
@@ -87,6 +93,7 @@ void DrawBitmap(uint8_t *black, uint8_t *color, uint16_t x, uint16_t y, uint16_t
     memset(bitmap4bit, 0, totalSize); // Initialize to white (0)
     
     int ePaperBytesPerRow = (w + 7) / 8;
+    energy_add(ENERGY_SPI, ENERGY_SPI_US(ePaperBytesPerRow * h * (color ? 2 : 1)));
     for (int row = 0; row < h; row++) {
         for (int col = 0; col < w; col++) {
             int bytePos = row * ePaperBytesPerRow + col / 8;
@@ -234,12 +241,33 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
                 .timestamp       = g_display_time,
                 .week_start      = g_week_start,
                 .temperature     = 25,
-                .voltage         = 3.2f,
+                .voltage         = 3200,
+                .battery         = 88,
                 .ssid            = "NRF_EPD_84AC",
+                .arena           = (uint8_t *)g_arena,
+                .arena_size      = sizeof(g_arena),
             };
             
             // Call DrawGUI to render the interface
+            LARGE_INTEGER freq, start, end;
+            QueryPerformanceFrequency(&freq);
+            QueryPerformanceCounter(&start);
             DrawGUI(&data, DrawBitmap, g_display_mode);
+            QueryPerformanceCounter(&end);
+
+            // Account the render as the firmware would, with a modeled panel refresh
+            energy_add(ENERGY_CPU, (uint32_t)((end.QuadPart - start.QuadPart) * 1000000 / freq.QuadPart));
+            energy_add(ENERGY_EPD_BUSY, (g_bwr_mode ? REFRESH_MS_BWR : REFRESH_MS_BW) * 1000);
+            energy_refresh(g_display_mode == MODE_CLOCK ? ENERGY_REFRESH_CLOCK : ENERGY_REFRESH_CALENDAR);
+
+            uint32_t refreshes = 0, charge = 0;
+            for (int i = 0; i < ENERGY_REFRESH_TYPES; i++)
+                refreshes += energy_refreshes((energy_refresh_t)i);
+            for (int i = 0; i < ENERGY_SUBSYS_COUNT; i++)
+                charge += energy_charge_uah((energy_subsys_t)i);
+            wchar_t title[64];
+            _snwprintf(title, 64, L"模拟器 - 刷新 %u 次, 约 %u uAh", refreshes, charge);
+            SetWindowTextW(hwnd, title);
             
             // Clear the global HDC
             g_paintHDC = NULL;
@@ -318,6 +346,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 // Main entry point
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
     g_hInstance = hInstance;
+    energy_init(&g_energy);
     
     // Register window class
     WNDCLASSW wc = {0};
@@ -384,6 +384,9 @@ function handleNotify(value, idx) {
         parseInt(msg.substring(2)) + new Date().getTimezoneOffset() * 60;
       addLog(`远端时间: ${new Date(t * 1000).toLocaleString()}`);
       addLog(`本地时间: ${new Date().toLocaleString()}`);
+    } else if (msg.startsWith("skip=") && msg.length > 5) {
+      const [mv, retry] = msg.substring(5).split(",").map((v) => parseInt(v));
+      addLog(`电池电压过低 (${mv} mV)，跳过刷新，${retry} 秒后重试`);
     }
   }
 }
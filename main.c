@@ -10,7 +10,10 @@
  *
  */
 
+#include <errno.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include "nordic_common.h"
 #include "nrf.h"
@@ -33,12 +36,14 @@
 #endif
 #include "nrf_power.h"
 #include "app_error.h"
+#include "app_util_platform.h"
 #include "app_timer.h"
 #include "app_scheduler.h"
 #include "nrf_drv_gpiote.h"
 #include "nrf_drv_wdt.h"
 #include "nrf_pwr_mgmt.h"
 #include "EPD_service.h"
+#include "EPD_energy.h"
 #include "main.h"
 
 #include "nrf_log.h"
@@ -51,22 +56,26 @@
 #define PERIPHERAL_LINK_COUNT           1                                               /**< Number of peripheral links used by the application. When changing this number remember to adjust the RAM settings*/
 
 #define DEVICE_NAME                      "NRF_EPD"                                      /**< Name of device. Will be included in the advertising data. */
-#define APP_ADV_INTERVAL                 1600                                           /**< The advertising interval (in units of 0.625 ms. This value corresponds to 1 s). */
-#define APP_ADV_TIMEOUT_IN_SECONDS       120                                            /**< The advertising timeout (in units of seconds). */
-#define APP_TIMER_PRESCALER              0                                              /**< Value of the RTC1 PRESCALER register. */
-#define APP_TIMER_OP_QUEUE_SIZE          4                                              /**< Size of timer operation queues. */
+#define APP_ADV_FAST_INTERVAL            100                                            /**< Default fast advertising interval (in units of 10 ms, 1 s). */
+#define APP_ADV_FAST_TIMEOUT             120                                            /**< Default fast advertising time (in seconds). */
+#define APP_ADV_SLOW_INTERVAL            50                                             /**< Default slow advertising interval (in units of 100 ms, 5 s). */
+#define APP_ADV_SLOW_TIMEOUT             60                                             /**< Default slow advertising time (in minutes). */
+#define APP_ADV_BURST_PERIOD             10                                             /**< Default time between advertising bursts (in minutes). */
+#define APP_ADV_BURST_DURATION           10                                             /**< Length of an advertising burst (in seconds). */
+#define APP_ADV_TIMER_INTERVAL           TIMER_TICKS(60000)                             /**< Advertising schedule timer interval (1 minute). */
+#define APP_TIMER_OP_QUEUE_SIZE          8                                              /**< Size of timer operation queues. */
 
 #if defined(S112)
 #define APP_BLE_CONN_CFG_TAG            1                                               /**< A tag identifying the SoftDevice BLE configuration. */
+#define APP_ADV_TIMEOUT(S)              ((S) * 100)                                     /**< Advertising timeout in units of 10 ms. */
 #define APP_BLE_OBSERVER_PRIO           3                                               /**< Application's BLE observer priority. You shouldn't need to modify this value. */
-#define TIMER_TICKS(MS) APP_TIMER_TICKS(MS)
 #else
-#define TIMER_TICKS(MS) APP_TIMER_TICKS(MS, APP_TIMER_PRESCALER)
 // Low frequency clock source to be used by the SoftDevice
 #define NRF_CLOCK_LFCLKSRC      {.source        = NRF_CLOCK_LF_SRC_RC,               \
                                  .rc_ctiv       = 16,                                \
                                  .rc_temp_ctiv  = 2,                                 \
                                  .xtal_accuracy = 0}
+#define APP_ADV_TIMEOUT(S)              (S)                                             /**< Advertising timeout in units of seconds. */
 #endif
 
 #define MIN_CONN_INTERVAL                MSEC_TO_UNITS(7.5, UNIT_1_25_MS)               /**< Minimum connection interval (7.5 ms) */
@@ -77,13 +86,62 @@
 #define NEXT_CONN_PARAMS_UPDATE_DELAY    TIMER_TICKS(30000)                             /**< Time between each call to sd_ble_gap_conn_param_update after the first call (30 seconds). */
 #define MAX_CONN_PARAMS_UPDATE_COUNT     3                                              /**< Number of attempts before giving up the connection parameter negotiation. */
 
+#define FAST_MIN_CONN_INTERVAL           MSEC_TO_UNITS(15, UNIT_1_25_MS)                /**< Minimum connection interval while transferring data (15 ms, the lowest iOS accepts). */
+#define FAST_MAX_CONN_INTERVAL           MSEC_TO_UNITS(30, UNIT_1_25_MS)                /**< Maximum connection interval while transferring data (30 ms). */
+#define FAST_SLAVE_LATENCY               0                                              /**< Slave latency while transferring data. */
+#define FAST_CONN_SUP_TIMEOUT            MSEC_TO_UNITS(2000, UNIT_10_MS)                /**< Connection supervisory timeout while transferring data (2 seconds). */
+#define IDLE_MIN_CONN_INTERVAL           MSEC_TO_UNITS(375, UNIT_1_25_MS)               /**< Minimum connection interval of an idle connection (375 ms). */
+#define IDLE_MAX_CONN_INTERVAL           MSEC_TO_UNITS(390, UNIT_1_25_MS)               /**< Maximum connection interval of an idle connection (390 ms, iOS wants interval * (latency + 1) <= 2 s). */
+#define IDLE_SLAVE_LATENCY               4                                              /**< Slave latency of an idle connection. */
+#define IDLE_CONN_SUP_TIMEOUT            MSEC_TO_UNITS(6000, UNIT_10_MS)                /**< Connection supervisory timeout of an idle connection (6 seconds). */
+#define CONN_IDLE_TIMEOUT                TIMER_TICKS(10000)                             /**< Time without transfer activity before switching to the idle parameters (10 seconds). */
+
 #define SCHED_MAX_EVENT_DATA_SIZE       EPD_GUI_SCHD_EVENT_DATA_SIZE                    /**< Maximum size of scheduler events. */
 #define SCHED_QUEUE_SIZE                10                                              /**< Maximum number of events in the scheduler queue. */
 
-#define CLOCK_TIMER_INTERVAL             TIMER_TICKS(1000)                              /**< Clock timer interval (ticks). */
+#define CLOCK_WAKEUP_MAX                 240                                            /**< Longest clock timer sleep (seconds), stays below half of the 24-bit RTC1 wrap. */
+#define CLOCK_RETAINED_MAGIC             0x434C4B32                                     /**< Marks a valid retained clock record ("CLK2"). */
+#define CLOCK_CAL_MIN_PERIOD             (6 * 60 * 60)                                  /**< Shortest time between syncs used to estimate the drift (seconds). */
+#define CLOCK_CAL_MAX_ERROR_PPM          2000                                           /**< Larger sync errors are treated as a clock change, not drift. */
+#define CLOCK_DRIFT_MAX_PPM              20000                                          /**< Limit of the drift correction. */
+#define WDT_FEED_INTERVAL                30                                             /**< WDT feed interval (seconds), half of the WDT reload value. */
+#define WDT_TIMER_INTERVAL               TIMER_TICKS(WDT_FEED_INTERVAL * 1000)          /**< WDT timer interval (ticks). */
+#define LED_BLINK_INTERVAL               TIMER_TICKS(100)                               /**< LED on time of a blink (ticks). */
+
+#define BEACON_COMPANY_ID                0xFFFF                                         /**< Company identifier of the status beacon (0xFFFF is the Bluetooth SIG test value, not assigned to any company). */
+#define BEACON_DATA_LEN                  10                                             /**< Length of the status beacon payload. */
+#define BEACON_NAME_MAX_LEN              (31 - 3 - (4 + BEACON_DATA_LEN) - 2)           /**< Name bytes left in the 31-byte advertising packet after the flags and the beacon. */
 
 #define DEAD_BEEF                        0xDEADBEEF                                     /**< Value used as error code on stack dump, can be used to identify stack location on stack unwind. */
 
+typedef struct
+{
+    uint32_t magic;                                                                     /**< CLOCK_RETAINED_MAGIC when valid. */
+    uint32_t timestamp;                                                                 /**< Timestamp when last retained. */
+    uint32_t ticks;                                                                     /**< RTC1 counter when the timestamp was retained. */
+    uint32_t frac;                                                                      /**< Ticks counted towards the next second at that time. */
+    uint32_t reset_ticks;                                                               /**< RTC1 counter right before a reset, equals ticks if unknown. */
+    uint32_t sync_time;                                                                 /**< Timestamp of the calibration baseline sync, 0 if none. */
+    int32_t  sync_error;                                                                /**< Clock error (seconds) accumulated since the baseline sync. */
+    int32_t  drift_ppm;                                                                 /**< Drift correction applied to the RTC1 ticks. */
+    uint32_t check;                                                                     /**< Inverted sum of the fields above. */
+} clock_retained_t;
+
+typedef enum
+{
+    ADV_STAGE_FAST,                                                                     /**< Fast advertising after wakeup or disconnect, then slow advertising. */
+    ADV_STAGE_SLOW,                                                                     /**< Slow advertising, ended by the schedule timer. */
+    ADV_STAGE_WAIT,                                                                     /**< Not advertising until the next burst. */
+    ADV_STAGE_BURST,                                                                    /**< Short fast advertising burst. */
+} adv_stage_t;
+
+typedef enum
+{
+    CONN_PARAMS_DEFAULT,                                                                /**< Parameters negotiated from the PPCP. */
+    CONN_PARAMS_FAST,                                                                   /**< Short interval without latency for data transfers. */
+    CONN_PARAMS_IDLE,                                                                   /**< Long interval with latency for idle connections. */
+} conn_params_mode_t;
+
 #if defined(S112)
 NRF_BLE_GATT_DEF(m_gatt);                                                               /**< GATT module instance. */
 BLE_ADVERTISING_DEF(m_advertising);                                                     /**< Advertising module instance. */
@@ -91,12 +149,29 @@ BLE_ADVERTISING_DEF(m_advertising);
 static ble_dfu_t                         m_dfus;                                        /**< Structure used to identify the DFU service. */
 #endif
 static uint16_t                          m_conn_handle = BLE_CONN_HANDLE_INVALID;       /**< Handle of the current connection. */
+static conn_params_mode_t                m_conn_params_mode = CONN_PARAMS_DEFAULT;      /**< Connection parameters currently requested. */
+static uint32_t                          m_conn_last_transfer;                          /**< RTC1 ticks of the last transfer activity. */
 static ble_uuid_t                        m_adv_uuids[] = {{BLE_UUID_EPD_SVC, \
                                                            EPD_SVC_UUID_TYPE}};         /**< Universally unique service identifier. */
 
 BLE_EPD_DEF(m_epd);                                                                     /**< Structure to identify the EPD Service. */
-static uint32_t                          m_timestamp = 1735689600;                      /**< Current timestamp. */
-APP_TIMER_DEF(m_clock_timer_id);                                                        /**< Clock timer. */
+static uint32_t                          m_timestamp = 1735689600;                      /**< Current timestamp, advanced from the RTC1 counter. */
+static uint32_t                          m_uptime;                                      /**< Seconds since boot. */
+static uint32_t                          m_clock_last;                                  /**< RTC1 counter when the clock was last advanced. */
+static uint32_t                          m_clock_frac;                                  /**< Ticks counted towards the next second. */
+static int32_t                           m_drift_rem;                                   /**< Remainder of the drift correction (ppm ticks). */
+static clock_retained_t                  m_clock_retained NOINIT;                       /**< Clock state kept across soft and WDT resets. */
+static energy_counters_t                 m_energy_counters NOINIT;                      /**< Energy counters kept across resets and system off. */
+static uint8_t                           m_beacon_data[BEACON_DATA_LEN];                /**< Status beacon payload. */
+APP_TIMER_DEF(m_clock_timer_id);                                                        /**< Clock timer, fires at display deadlines. */
+APP_TIMER_DEF(m_wdt_timer_id);                                                          /**< WDT timer, wakes the main loop to feed the WDT. */
+APP_TIMER_DEF(m_conn_idle_timer_id);                                                    /**< Connection idle timer. */
+APP_TIMER_DEF(m_adv_timer_id);                                                          /**< Advertising schedule timer, ticks every minute. */
+APP_TIMER_DEF(m_led_timer_id);                                                          /**< Turns the LED off after a blink. */
+static uint32_t                          m_boot_ticks[BOOT_PHASES];                     /**< RTC1 counter at the end of each boot phase. */
+static uint8_t                           m_boot_done;                                   /**< Bit mask of the boot phases stamped. */
+static adv_stage_t                       m_adv_stage = ADV_STAGE_FAST;                  /**< Current advertising stage. */
+static uint8_t                           m_adv_minutes;                                 /**< Minutes left in the current advertising stage. */
 static nrf_drv_wdt_channel_id            m_wdt_channel_id;
 static uint32_t                          m_wdt_last_feed_time = 0;
 static uint32_t                          m_resetreas;
@@ -117,27 +192,304 @@ void assert_nrf_callback(uint16_t line_num, const uint8_t * p_file_name)
     app_error_handler(DEAD_BEEF, line_num, p_file_name);
 }
 
+static uint32_t clock_retained_check(clock_retained_t const * p_retained)
+{
+    return ~(p_retained->magic + p_retained->timestamp + p_retained->ticks + p_retained->frac +
+             p_retained->reset_ticks + p_retained->sync_time +
+             (uint32_t)p_retained->sync_error + (uint32_t)p_retained->drift_ppm);
+}
+
+// save the clock to no-init RAM
+static void clock_retain(void)
+{
+    m_clock_retained.magic = CLOCK_RETAINED_MAGIC;
+    m_clock_retained.timestamp = m_timestamp;
+    m_clock_retained.ticks = m_clock_last;
+    m_clock_retained.frac = m_clock_frac;
+    m_clock_retained.reset_ticks = m_clock_last;
+    m_clock_retained.check = clock_retained_check(&m_clock_retained);
+}
+
+// stamp the RTC1 counter before a reset, restore adds the ticks since the last retain back
+void clock_prepare_reset(void)
+{
+    CRITICAL_REGION_ENTER();
+    m_clock_retained.reset_ticks = app_timer_cnt_get();
+    m_clock_retained.check = clock_retained_check(&m_clock_retained);
+    CRITICAL_REGION_EXIT();
+}
+
+// restore the clock after a reset which kept the RAM, return true when valid
+static bool clock_restore(void)
+{
+    bool valid = m_clock_retained.magic == CLOCK_RETAINED_MAGIC &&
+                 m_clock_retained.check == clock_retained_check(&m_clock_retained) &&
+                 m_clock_retained.drift_ppm >= -CLOCK_DRIFT_MAX_PPM &&
+                 m_clock_retained.drift_ppm <= CLOCK_DRIFT_MAX_PPM;
+    if (valid && (m_resetreas & (NRF_POWER_RESETREAS_DOG_MASK | NRF_POWER_RESETREAS_SREQ_MASK |
+                                 NRF_POWER_RESETREAS_LOCKUP_MASK | NRF_POWER_RESETREAS_RESETPIN_MASK))) {
+        // RTC1 restarts from zero, add the ticks counted between the last retain and the reset
+        clock_retained_t * p = &m_clock_retained;
+        int64_t lost = ticks_diff(p->reset_ticks, p->ticks);
+        lost -= lost * p->drift_ppm / 1000000;
+        lost += p->frac;
+        m_timestamp = p->timestamp + (uint32_t)(lost / TIMER_CLOCK_FREQ);
+        m_clock_frac = (uint32_t)(lost % TIMER_CLOCK_FREQ);
+        NRF_LOG_INFO("Clock restored: %d, drift %d ppm\n", m_timestamp, p->drift_ppm);
+        clock_retain();
+        return true;
+    }
+
+    // power on or wakeup from system off, the time is lost but keep the calibration
+    if (!valid) {
+        m_clock_retained.sync_time = 0;
+        m_clock_retained.sync_error = 0;
+        m_clock_retained.drift_ppm = 0;
+    }
+    clock_retain();
+    return false;
+}
+
+// advance the clock by the RTC1 ticks elapsed since the last call
+static void clock_update(void)
+{
+    CRITICAL_REGION_ENTER();
+    uint32_t now = app_timer_cnt_get();
+    uint32_t diff = ticks_diff(now, m_clock_last);
+    m_clock_last = now;
+
+    // a positive drift means the clock runs fast, drop the extra ticks
+    int64_t corr = (int64_t)diff * m_clock_retained.drift_ppm + m_drift_rem;
+    int32_t adj = (int32_t)(corr / 1000000);
+    m_drift_rem = (int32_t)(corr - (int64_t)adj * 1000000);
+    m_clock_frac += diff - adj;
+
+    if (m_clock_frac >= TIMER_CLOCK_FREQ) {
+        uint32_t seconds = m_clock_frac / TIMER_CLOCK_FREQ;
+        m_clock_frac -= seconds * TIMER_CLOCK_FREQ;
+        m_timestamp += seconds;
+        m_uptime += seconds;
+        clock_retain();
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+// sleep until the next display deadline, or CLOCK_WAKEUP_MAX at most
+static void clock_timer_start(void)
+{
+    uint32_t ts = timestamp();
+    uint32_t seconds = ble_epd_next_update(&m_epd, ts);
+    if (seconds == 0 || seconds > CLOCK_WAKEUP_MAX)
+        seconds = CLOCK_WAKEUP_MAX;
+
+    // land on the second boundary, m_clock_frac is always below one second
+    uint32_t ticks = seconds * TIMER_CLOCK_FREQ - m_clock_frac;
+    // raw ticks needed to count that many corrected ticks, one more to not wake early
+    ticks = (uint32_t)((int64_t)ticks * 1000000 / (1000000 - m_clock_retained.drift_ppm)) + 1;
+    if (ticks < APP_TIMER_MIN_TIMEOUT_TICKS)
+        ticks += TIMER_CLOCK_FREQ;
+    APP_ERROR_CHECK(app_timer_start(m_clock_timer_id, ticks, NULL));
+}
+
+// estimate the drift from the error between two syncs
+static void clock_calibrate(uint32_t local, uint32_t timestamp)
+{
+    clock_retained_t * p = &m_clock_retained;
+    int32_t error = (int32_t)(local - timestamp);
+    int32_t elapsed = (int32_t)(timestamp - p->sync_time);
+
+    if (p->sync_time == 0 || elapsed <= 0 ||
+        (int64_t)abs(error) * 1000000 > (int64_t)elapsed * CLOCK_CAL_MAX_ERROR_PPM + 2000000) {
+        // first sync, or the time was changed (timezone, reset), start over
+        p->sync_time = timestamp;
+        p->sync_error = 0;
+        return;
+    }
+
+    p->sync_error += error;
+    NRF_LOG_DEBUG("Clock error: %d s in %d s\n", p->sync_error, elapsed);
+    if (elapsed >= CLOCK_CAL_MIN_PERIOD) {
+        int32_t ppm = p->drift_ppm + (int32_t)((int64_t)p->sync_error * 1000000 / elapsed);
+        if (ppm > CLOCK_DRIFT_MAX_PPM) ppm = CLOCK_DRIFT_MAX_PPM;
+        if (ppm < -CLOCK_DRIFT_MAX_PPM) ppm = -CLOCK_DRIFT_MAX_PPM;
+        NRF_LOG_INFO("Clock drift: %d ppm\n", ppm);
+        p->drift_ppm = ppm;
+        p->sync_time = timestamp;
+        p->sync_error = 0;
+    }
+}
+
 // return current timestamp
 uint32_t timestamp(void)
 {
+    clock_update();
     return m_timestamp;
 }
 
+// milliseconds since boot
+uint64_t uptime_ms(void)
+{
+    uint64_t ms;
+    CRITICAL_REGION_ENTER();
+    clock_update();
+    ms = (uint64_t)m_uptime * 1000 + TIMER_MS(m_clock_frac);
+    CRITICAL_REGION_EXIT();
+    return ms;
+}
+
 // set the timestamp
 void set_timestamp(uint32_t timestamp)
 {
     app_timer_stop(m_clock_timer_id);
+    clock_update();
+    clock_calibrate(m_timestamp, timestamp);
     m_timestamp = timestamp;
-    app_timer_start(m_clock_timer_id, CLOCK_TIMER_INTERVAL, NULL);
+    m_clock_frac = 0;
+    m_drift_rem = 0;
+    clock_retain();
+    clock_timer_start();
+}
+
+// re-arm the clock timer when the next display deadline moved earlier
+void clock_timer_restart(void)
+{
+    app_timer_stop(m_clock_timer_id);
+    clock_timer_start();
+}
+
+// number of RTC1 ticks from ticks_from to ticks_to
+uint32_t ticks_diff(uint32_t ticks_to, uint32_t ticks_from)
+{
+#if defined(S112)
+    return app_timer_cnt_diff_compute(ticks_to, ticks_from);
+#else
+    uint32_t diff = 0;
+    app_timer_cnt_diff_compute(ticks_to, ticks_from, &diff);
+    return diff;
+#endif
+}
+
+#if defined(__GNUC__)
+extern uint8_t __HeapBase[], __HeapLimit[];
+
+// newlib lets malloc grow up to the stack pointer, keep it inside the heap
+// section since the RAM above belongs to the render arena
+void *_sbrk(ptrdiff_t incr)
+{
+    static uint8_t *heap_end = __HeapBase;
+    uint8_t *prev = heap_end;
+
+    if (incr > __HeapLimit - heap_end) {
+        errno = ENOMEM;
+        return (void *)-1;
+    }
+    heap_end += incr;
+    return prev;
+}
+#else
+extern uint8_t Image$$RW_IRAM1$$ZI$$Limit[];
+#endif
+
+#if defined(__GNUC__)
+extern uint8_t __start_noinit[];
+extern uint8_t __stop_noinit[];
+#define NOINIT_START __start_noinit
+#define NOINIT_END   __stop_noinit
+#else
+extern uint8_t Image$$RW_NOINIT$$Base[];
+extern uint8_t Image$$RW_NOINIT$$ZI$$Limit[];
+#define NOINIT_START Image$$RW_NOINIT$$Base
+#define NOINIT_END   Image$$RW_NOINIT$$ZI$$Limit
+#endif
+
+/**@brief Function for keeping the NOINIT variables powered in system off.
+ *
+ * @details Only the RAM holding them is retained. Retention has a cost in system off. On the
+ *          nRF51, the product specification gives about 0.6 uA with no RAM retained and about
+ *          1.2 uA with one 8 KB block retained. On the nRF52811, each retained 4 KB section
+ *          adds a few tens of nA.
+ */
+static void noinit_retain(void)
+{
+    uint32_t first = (uint32_t)NOINIT_START - 0x20000000;
+    uint32_t last = (uint32_t)NOINIT_END - 1 - 0x20000000;
+#if defined(S112)
+    for (uint32_t i = first / 4096; i <= last / 4096; i++) // two 4 KB sections per RAM block
+        sd_power_ram_power_set(i / 2, POWER_RAM_POWER_S0RETENTION_Msk << (i % 2));
+#else
+    uint32_t ramon = POWER_RAMON_ONRAM0_Msk | POWER_RAMON_ONRAM1_Msk;
+    for (uint32_t i = first / NRF_FICR->SIZERAMBLOCKS; i <= last / NRF_FICR->SIZERAMBLOCKS; i++)
+        ramon |= POWER_RAMON_OFFRAM0_Msk << i;
+    sd_power_ramon_set(ramon);
+#endif
+}
+
+// RAM the SoftDevice, the data, the heap and the stack leave free, sized by the linker
+uint8_t *render_arena(uint32_t *size)
+{
+#if defined(__GNUC__)
+    uint8_t *start = __HeapLimit;
+    uint8_t *end = (uint8_t *)STACK_BASE;
+#else
+    // the stack and the heap are zero-initialized data, the RAM above it is free
+    uint8_t *start = Image$$RW_IRAM1$$ZI$$Limit;
+#if defined(S112)
+    uint8_t *end = (uint8_t *)(0x20000000 + NRF_FICR->INFO.RAM * 1024);
+#else
+    uint8_t *end = (uint8_t *)(0x20000000 + NRF_FICR->NUMRAMBLOCK * NRF_FICR->SIZERAMBLOCKS);
+#endif
+#endif
+    start = (uint8_t *)(((uint32_t)start + 3) & ~3);
+    *size = end > start ? end - start : 0;
+    return start;
 }
 
 // reload the wdt channel
 void app_feed_wdt(void)
 {
-    if (m_timestamp - m_wdt_last_feed_time >= 30) {
+    clock_update();
+    if (m_uptime - m_wdt_last_feed_time >= WDT_FEED_INTERVAL) {
         NRF_LOG_DEBUG("Feed WDT\n");
         nrf_drv_wdt_channel_feed(m_wdt_channel_id);
-        m_wdt_last_feed_time = m_timestamp;
+        m_wdt_last_feed_time = m_uptime;
+    }
+}
+
+// advertising setting from the config, 0xFF selects the default
+static uint8_t adv_config(uint8_t value, uint8_t def)
+{
+    return value == 0xFF ? def : value;
+}
+
+// an interval or a timeout of 0 is meaningless, treat it as unset too
+static uint8_t adv_config_nonzero(uint8_t value, uint8_t def)
+{
+    return value == 0 ? def : adv_config(value, def);
+}
+
+/**@brief Function for getting the advertising modes of a stage.
+ *
+ * @param[out] p_config  Advertising modes.
+ * @param[in]  burst     True for a sparse advertising burst, false for fast then slow advertising.
+ */
+static void advertising_modes_get(ble_adv_modes_config_t * p_config, bool burst)
+{
+    epd_config_t * p_cfg = &m_epd.config;
+    uint8_t fast_interval = MAX(adv_config_nonzero(p_cfg->adv_fast_interval, APP_ADV_FAST_INTERVAL), 2);
+    uint8_t fast_timeout  = adv_config_nonzero(p_cfg->adv_fast_timeout, APP_ADV_FAST_TIMEOUT);
+    uint8_t slow_interval = adv_config_nonzero(p_cfg->adv_slow_interval, APP_ADV_SLOW_INTERVAL);
+
+    memset(p_config, 0, sizeof(ble_adv_modes_config_t));
+
+    p_config->ble_adv_fast_enabled  = true;
+    p_config->ble_adv_fast_interval = MSEC_TO_UNITS(fast_interval * 10, UNIT_0_625_MS);
+    p_config->ble_adv_fast_timeout  = APP_ADV_TIMEOUT(burst ? APP_ADV_BURST_DURATION : fast_timeout);
+
+    // slow advertising does not time out, the schedule timer ends it
+    if (!burst && adv_config(p_cfg->adv_slow_timeout, APP_ADV_SLOW_TIMEOUT) > 0) {
+        p_config->ble_adv_slow_enabled  = true;
+        p_config->ble_adv_slow_interval = MSEC_TO_UNITS(slow_interval * 100, UNIT_0_625_MS);
+        p_config->ble_adv_slow_timeout  = 0;
     }
 }
 
@@ -162,11 +514,7 @@ NRF_SDH_STATE_OBSERVER(m_buttonless_dfu_state_obs, 0) =
 
 static void advertising_config_get(ble_adv_modes_config_t * p_config)
 {
-    memset(p_config, 0, sizeof(ble_adv_modes_config_t));
-
-    p_config->ble_adv_fast_enabled  = true;
-    p_config->ble_adv_fast_interval = APP_ADV_INTERVAL;
-    p_config->ble_adv_fast_timeout  = APP_ADV_TIMEOUT_IN_SECONDS * 100;
+    advertising_modes_get(p_config, false);
 }
 
 static void ble_dfu_evt_handler(ble_dfu_buttonless_evt_type_t event)
@@ -236,9 +584,117 @@ static void clock_timer_timeout_handler(void * p_context)
 {
     UNUSED_PARAMETER(p_context);
 
-    m_timestamp++;
+    ble_epd_on_timer(&m_epd, timestamp(), false);
+    clock_timer_start();
+}
 
-    ble_epd_on_timer(&m_epd, m_timestamp, false);
+static void wdt_timer_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    // The WDT is fed from the main loop. Keeping this timer running also
+    // keeps RTC1 counting, which the clock is derived from.
+    energy_checkpoint(uptime_ms());
+}
+
+static void led_timer_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    EPD_LED_BLINK(false);
+}
+
+/**@brief Function for blinking the LED without blocking, the timer turns it off.
+ */
+static void led_blink(void)
+{
+    EPD_LED_BLINK(true);
+    app_timer_stop(m_led_timer_id);
+    APP_ERROR_CHECK(app_timer_start(m_led_timer_id, LED_BLINK_INTERVAL, NULL));
+}
+
+void boot_phase_end(boot_phase_t phase)
+{
+    if (m_boot_done & (1 << phase)) return;
+    m_boot_done |= 1 << phase;
+    m_boot_ticks[phase] = app_timer_cnt_get();
+    NRF_LOG_INFO("boot phase %d: %d ms\n", phase, TIMER_MS(m_boot_ticks[phase]));
+}
+
+// microseconds from the LFCLK start to the end of each phase, little endian, 0 if not reached yet
+uint16_t boot_encode(uint8_t *buf)
+{
+    for (uint8_t i = 0; i < BOOT_PHASES; i++) {
+        uint32_t us = 0;
+        if (m_boot_done & (1 << i))
+            us = (uint32_t)((uint64_t)m_boot_ticks[i] * 1000000 / TIMER_CLOCK_FREQ);
+        uint32_encode(us, buf + i * 4);
+    }
+    return BOOT_DATA_LEN;
+}
+
+/**@brief Function for requesting a new set of connection parameters.
+ *
+ * @param[in] mode  Connection parameters to request.
+ */
+static void conn_params_request(conn_params_mode_t mode)
+{
+    ble_gap_conn_params_t conn_params;
+
+    switch (mode)
+    {
+        case CONN_PARAMS_FAST:
+            conn_params.min_conn_interval = FAST_MIN_CONN_INTERVAL;
+            conn_params.max_conn_interval = FAST_MAX_CONN_INTERVAL;
+            conn_params.slave_latency     = FAST_SLAVE_LATENCY;
+            conn_params.conn_sup_timeout  = FAST_CONN_SUP_TIMEOUT;
+            break;
+        case CONN_PARAMS_IDLE:
+            conn_params.min_conn_interval = IDLE_MIN_CONN_INTERVAL;
+            conn_params.max_conn_interval = IDLE_MAX_CONN_INTERVAL;
+            conn_params.slave_latency     = IDLE_SLAVE_LATENCY;
+            conn_params.conn_sup_timeout  = IDLE_CONN_SUP_TIMEOUT;
+            break;
+        default:
+            conn_params.min_conn_interval = MIN_CONN_INTERVAL;
+            conn_params.max_conn_interval = MAX_CONN_INTERVAL;
+            conn_params.slave_latency     = SLAVE_LATENCY;
+            conn_params.conn_sup_timeout  = CONN_SUP_TIMEOUT;
+            break;
+    }
+
+    NRF_LOG_DEBUG("request conn params: mode=%d\n", mode);
+    m_conn_params_mode = mode;
+    // Errors are not fatal here, the link just keeps its current parameters.
+#if defined(S112)
+    ble_conn_params_change_conn_params(m_conn_handle, &conn_params);
+#else
+    ble_conn_params_change_conn_params(&conn_params);
+#endif
+}
+
+static void conn_idle_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    if (m_conn_handle == BLE_CONN_HANDLE_INVALID) return;
+
+    uint32_t idle = ticks_diff(app_timer_cnt_get(), m_conn_last_transfer);
+    if (idle < CONN_IDLE_TIMEOUT)
+        APP_ERROR_CHECK(app_timer_start(m_conn_idle_timer_id, CONN_IDLE_TIMEOUT - idle, NULL));
+    else
+        conn_params_request(CONN_PARAMS_IDLE);
+}
+
+// switch to the fast connection parameters while data is being transferred
+void conn_params_on_transfer(void)
+{
+    if (m_conn_handle == BLE_CONN_HANDLE_INVALID) return;
+
+    m_conn_last_transfer = app_timer_cnt_get();
+    if (m_conn_params_mode != CONN_PARAMS_FAST)
+    {
+        conn_params_request(CONN_PARAMS_FAST);
+        APP_ERROR_CHECK(app_timer_start(m_conn_idle_timer_id, CONN_IDLE_TIMEOUT, NULL));
+    }
 }
 
 /**@brief Function for the Event Scheduler initialization.
@@ -262,8 +718,19 @@ static void timers_init(void)
 #endif
     // Create timers.
     APP_ERROR_CHECK(app_timer_create(&m_clock_timer_id,
-                                     APP_TIMER_MODE_REPEATED,
+                                     APP_TIMER_MODE_SINGLE_SHOT,
                                      clock_timer_timeout_handler));
+    APP_ERROR_CHECK(app_timer_create(&m_conn_idle_timer_id,
+                                     APP_TIMER_MODE_SINGLE_SHOT,
+                                     conn_idle_timeout_handler));
+    APP_ERROR_CHECK(app_timer_create(&m_wdt_timer_id,
+                                     APP_TIMER_MODE_REPEATED,
+                                     wdt_timer_timeout_handler));
+    APP_ERROR_CHECK(app_timer_create(&m_led_timer_id,
+                                     APP_TIMER_MODE_SINGLE_SHOT,
+                                     led_timer_timeout_handler));
+    // Start the WDT timer right away so RTC1 counts from the LFCLK start, for the boot profile.
+    APP_ERROR_CHECK(app_timer_start(m_wdt_timer_id, WDT_TIMER_INTERVAL, NULL));
 }
 
 /**@brief Function for starting application timers.
@@ -271,7 +738,8 @@ static void timers_init(void)
 static void application_timers_start(void)
 {
     // Start application timers.
-    APP_ERROR_CHECK(app_timer_start(m_clock_timer_id, CLOCK_TIMER_INTERVAL, NULL));
+    m_clock_last = app_timer_cnt_get();
+    clock_timer_start();
 }
 
 /**@brief Function for putting the chip into sleep mode.
@@ -285,6 +753,10 @@ void sleep_mode_enter(void)
     nrf_delay_ms(100);
 
     ble_epd_sleep_prepare(&m_epd);
+
+    // retain the NOINIT RAM in system off, so the energy counters survive the sleep
+    energy_checkpoint(uptime_ms());
+    noinit_retain();
     nrf_pwr_mgmt_shutdown(NRF_PWR_MGMT_SHUTDOWN_GOTO_SYSOFF);
 }
 
@@ -334,7 +806,7 @@ static void gap_params_init(void)
                    addr.addr[5], addr.addr[4], addr.addr[3],
                    addr.addr[2], addr.addr[1], addr.addr[0]);
 
-    snprintf(device_name, 20, "%s_%02X%02X", DEVICE_NAME, addr.addr[1],addr.addr[0]);
+    GFX_snprintf(device_name, 20, "%s_%02X%02X", DEVICE_NAME, addr.addr[1],addr.addr[0]);
     APP_ERROR_CHECK(sd_ble_gap_device_name_set(&sec_mode,
                                                (const uint8_t *)device_name,
                                                strlen(device_name)));
@@ -364,6 +836,12 @@ static void on_conn_params_evt(ble_conn_params_evt_t * p_evt)
 {
     if (p_evt->evt_type == BLE_CONN_PARAMS_EVT_FAILED)
     {
+        // The central is free to refuse the fast and idle parameters, keep the link anyway.
+        if (m_conn_params_mode != CONN_PARAMS_DEFAULT)
+        {
+            NRF_LOG_INFO("conn params rejected: mode=%d\n", m_conn_params_mode);
+            return;
+        }
         APP_ERROR_CHECK(sd_ble_gap_disconnect(m_conn_handle, BLE_HCI_CONN_INTERVAL_UNACCEPTABLE));
     }
 }
@@ -400,9 +878,32 @@ static void conn_params_init(void)
 }
 
 
-static void advertising_start(void)
+static void on_adv_evt(ble_adv_evt_t ble_adv_evt);
+static void advdata_build(ble_advdata_t * p_advdata, ble_advdata_t * p_srdata, ble_advdata_manuf_data_t * p_manuf_data);
+
+static void advertising_modes_set(bool burst)
 {
-    NRF_LOG_INFO("advertising start\n");
+    ble_adv_modes_config_t config;
+
+    advertising_modes_get(&config, burst);
+#if defined(S112)
+    ble_advertising_modes_config_set(&m_advertising, &config);
+#else
+    // no setter in this SDK version, init again with the new modes
+    ble_advdata_t            advdata;
+    ble_advdata_t            scanrsp;
+    ble_advdata_manuf_data_t manuf_data;
+
+    advdata_build(&advdata, &scanrsp, &manuf_data);
+    APP_ERROR_CHECK(ble_advertising_init(&advdata, &scanrsp, &config, on_adv_evt, NULL));
+#endif
+}
+
+static void advertising_mode_start(bool burst)
+{
+    app_timer_stop(m_adv_timer_id);
+    advertising_modes_set(burst);
+    m_adv_stage = burst ? ADV_STAGE_BURST : ADV_STAGE_FAST;
 #if defined(S112)
     APP_ERROR_CHECK(ble_advertising_start(&m_advertising, BLE_ADV_MODE_FAST));
 #else
@@ -410,6 +911,22 @@ static void advertising_start(void)
 #endif
 }
 
+// start the advertising schedule from the fast stage
+static void advertising_start(void)
+{
+    NRF_LOG_INFO("advertising start\n");
+    advertising_mode_start(false);
+}
+
+// count down the current stage in minutes
+static void advertising_timer_start(adv_stage_t stage, uint8_t minutes)
+{
+    m_adv_stage = stage;
+    m_adv_minutes = minutes;
+    app_timer_stop(m_adv_timer_id);
+    APP_ERROR_CHECK(app_timer_start(m_adv_timer_id, APP_ADV_TIMER_INTERVAL, NULL));
+}
+
 void gpiote_evt_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action) {
     NRF_LOG_DEBUG("pin: %d, event: %d\n", pin, action);
 
@@ -417,10 +934,10 @@ void gpiote_evt_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action)
     nrf_drv_gpiote_in_uninit(pin);
     nrf_drv_gpiote_uninit();
 
-    // blink LED on wakeup
-    EPD_LED_BLINK();
-
     advertising_start();
+
+    // blink LED on wakeup
+    led_blink();
 }
 
 static void setup_wakeup_pin(nrf_drv_gpiote_pin_t pin) {
@@ -433,6 +950,58 @@ static void setup_wakeup_pin(nrf_drv_gpiote_pin_t pin) {
 }
 
 
+/**@brief Function for handling the end of the advertising stages.
+ *
+ * @details Tags with a wakeup pin sleep or wait for the pin, the others keep
+ *          advertising in sparse bursts, or restart the schedule if bursts are off.
+ */
+static void advertising_idle(void)
+{
+    uint8_t burst_period = adv_config(m_epd.config.adv_burst_period, APP_ADV_BURST_PERIOD);
+
+    if (m_epd.config.wakeup_pin != 0xFF) {
+        if (m_epd.config.display_mode == MODE_PICTURE)
+            sleep_mode_enter();
+        else
+            setup_wakeup_pin(m_epd.config.wakeup_pin);
+    } else if (burst_period > 0) {
+        advertising_timer_start(ADV_STAGE_WAIT, burst_period);
+    } else {
+        advertising_start();
+    }
+}
+
+static void adv_timer_handler(void * p_event_data, uint16_t event_size)
+{
+    if (m_adv_minutes > 0 && --m_adv_minutes > 0) return;
+    app_timer_stop(m_adv_timer_id);
+
+    switch (m_adv_stage)
+    {
+        case ADV_STAGE_SLOW:
+            NRF_LOG_INFO("slow advertising done\n");
+#if defined(S112)
+            sd_ble_gap_adv_stop(m_advertising.adv_handle);
+#else
+            sd_ble_gap_adv_stop();
+#endif
+            energy_stop(ENERGY_RADIO_ADV, uptime_ms());
+            advertising_idle();
+            break;
+        case ADV_STAGE_WAIT:
+            advertising_mode_start(true);
+            break;
+        default:
+            break;
+    }
+}
+
+static void adv_timer_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    app_sched_event_put(NULL, 0, adv_timer_handler);
+}
+
 /**@brief Function for handling advertising events.
  *
  * @details This function will be called for advertising events which are passed to the application.
@@ -444,16 +1013,22 @@ static void on_adv_evt(ble_adv_evt_t ble_adv_evt)
     switch (ble_adv_evt)
     {
         case BLE_ADV_EVT_FAST:
+            energy_start(ENERGY_RADIO_ADV, uptime_ms());
+            break;
+        case BLE_ADV_EVT_SLOW:
+            NRF_LOG_INFO("slow advertising\n");
+            energy_start(ENERGY_RADIO_ADV, uptime_ms());
+            advertising_timer_start(ADV_STAGE_SLOW, adv_config(m_epd.config.adv_slow_timeout, APP_ADV_SLOW_TIMEOUT));
             break;
         case BLE_ADV_EVT_IDLE:
             NRF_LOG_INFO("advertising timeout\n");
-            if (m_epd.config.wakeup_pin != 0xFF) {
-                if (m_epd.config.display_mode == MODE_PICTURE)
-                    sleep_mode_enter();
-                else
-                    setup_wakeup_pin(m_epd.config.wakeup_pin);
+            energy_stop(ENERGY_RADIO_ADV, uptime_ms());
+            if (m_adv_stage == ADV_STAGE_BURST) {
+                // next burst, the schedule starts over after a disconnect
+                advertising_modes_set(false);
+                advertising_timer_start(ADV_STAGE_WAIT, adv_config(m_epd.config.adv_burst_period, APP_ADV_BURST_PERIOD));
             } else {
-                advertising_start();
+                advertising_idle();
             }
             break;
         default:
@@ -472,15 +1047,33 @@ static void on_ble_evt(ble_evt_t * p_ble_evt)
         case BLE_GAP_EVT_CONNECTED:
             NRF_LOG_INFO("CONNECTED\n");
             m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+            energy_stop(ENERGY_RADIO_ADV, uptime_ms());
+            energy_start(ENERGY_RADIO_CONN, uptime_ms());
+            // a connection ends the stages, advertising starts fast again after it
+            app_timer_stop(m_adv_timer_id);
+            if (m_adv_stage != ADV_STAGE_FAST)
+                advertising_modes_set(false);
+            m_adv_stage = ADV_STAGE_FAST;
             break;
 
         case BLE_GAP_EVT_DISCONNECTED:
             NRF_LOG_INFO("DISCONNECTED\n");
             m_conn_handle = BLE_CONN_HANDLE_INVALID;
+            energy_stop(ENERGY_RADIO_CONN, uptime_ms());
+            app_timer_stop(m_conn_idle_timer_id);
+            if (m_conn_params_mode != CONN_PARAMS_DEFAULT)
+                conn_params_request(CONN_PARAMS_DEFAULT);
 #if !defined(S112)
             advertising_start();
 #endif
             break;
+
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+        {
+            ble_gap_conn_params_t const * p_params = &p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params;
+            NRF_LOG_INFO("conn params: interval=%d latency=%d timeout=%d\n",
+                         p_params->max_conn_interval, p_params->slave_latency, p_params->conn_sup_timeout);
+        } break;
 #if defined(S112)
         case BLE_GAP_EVT_PHY_UPDATE_REQUEST:
         {
@@ -657,25 +1250,89 @@ static void ble_options_set(void)
 }
 #endif
 
+/**@brief Function for encoding the status beacon.
+ *
+ * @details The beacon lets a passive scanner read the tag status without connecting:
+ *          battery voltage (mV), controller temperature, display mode, CRC16 of the
+ *          frame on screen and uptime (seconds), all little endian.
+ */
+static void beacon_encode(ble_advdata_manuf_data_t * p_manuf_data)
+{
+    uint8_t * p = m_beacon_data;
+
+    p += uint16_encode(m_epd.voltage, p);
+    *p++ = (uint8_t)m_epd.temperature;
+    *p++ = m_epd.config.display_mode;
+    p += uint16_encode(m_epd.frame_crc, p);
+    uint32_encode(m_uptime, p);
+
+    p_manuf_data->company_identifier = BEACON_COMPANY_ID;
+    p_manuf_data->data.p_data        = m_beacon_data;
+    p_manuf_data->data.size          = sizeof(m_beacon_data);
+}
+
+/**@brief Function for building the advertising and scan response data.
+ */
+static void advdata_build(ble_advdata_t * p_advdata, ble_advdata_t * p_srdata, ble_advdata_manuf_data_t * p_manuf_data)
+{
+    uint16_t name_len = 0;
+
+    beacon_encode(p_manuf_data);
+    APP_ERROR_CHECK(sd_ble_gap_device_name_get(NULL, &name_len));
+
+    memset(p_advdata, 0, sizeof(ble_advdata_t));
+    // SHORT_NAME always sends the shortened name AD type, so it is only used when the name does not fit
+    if (name_len <= BEACON_NAME_MAX_LEN)
+    {
+        p_advdata->name_type         = BLE_ADVDATA_FULL_NAME;
+    }
+    else
+    {
+        p_advdata->name_type         = BLE_ADVDATA_SHORT_NAME;
+        p_advdata->short_name_len    = BEACON_NAME_MAX_LEN;
+    }
+    p_advdata->include_appearance    = false;
+    p_advdata->flags                 = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE; // limited mode allows 180 s at most
+    p_advdata->p_manuf_specific_data = p_manuf_data;
+
+    memset(p_srdata, 0, sizeof(ble_advdata_t));
+    p_srdata->uuids_complete.uuid_cnt = sizeof(m_adv_uuids) / sizeof(m_adv_uuids[0]);
+    p_srdata->uuids_complete.p_uuids  = m_adv_uuids;
+}
+
+/**@brief Function for refreshing the status beacon in the advertising data.
+ */
+void advertising_update(void)
+{
+    ble_advdata_t            advdata;
+    ble_advdata_t            srdata;
+    ble_advdata_manuf_data_t manuf_data;
+
+    advdata_build(&advdata, &srdata, &manuf_data);
+#if defined(S112)
+    APP_ERROR_CHECK(ble_advertising_advdata_update(&m_advertising, &advdata, &srdata));
+#else
+    APP_ERROR_CHECK(ble_advdata_set(&advdata, &srdata));
+#endif
+}
+
 /**@brief Function for initializing the Advertising functionality.
  */
 static void advertising_init(void)
 {
+    ble_advdata_manuf_data_t manuf_data;
+
+    APP_ERROR_CHECK(app_timer_create(&m_adv_timer_id,
+                                     APP_TIMER_MODE_REPEATED,
+                                     adv_timer_timeout_handler));
 #if defined(S112)
     ble_advertising_init_t init;
 
     memset(&init, 0, sizeof(init));
 
-    init.advdata.name_type          = BLE_ADVDATA_FULL_NAME;
-    init.advdata.include_appearance = false;
-    init.advdata.flags              = BLE_GAP_ADV_FLAGS_LE_ONLY_LIMITED_DISC_MODE;
-
-    init.srdata.uuids_complete.uuid_cnt = sizeof(m_adv_uuids) / sizeof(m_adv_uuids[0]);
-    init.srdata.uuids_complete.p_uuids  = m_adv_uuids;
+    advdata_build(&init.advdata, &init.srdata, &manuf_data);
 
-    init.config.ble_adv_fast_enabled  = true;
-    init.config.ble_adv_fast_interval = APP_ADV_INTERVAL;
-    init.config.ble_adv_fast_timeout  = APP_ADV_TIMEOUT_IN_SECONDS * 100;
+    advertising_modes_get(&init.config, false);
     init.evt_handler = on_adv_evt;
 
     APP_ERROR_CHECK(ble_advertising_init(&m_advertising, &init));
@@ -687,19 +1344,9 @@ static void advertising_init(void)
     ble_adv_modes_config_t options;
 
     // Build advertising data struct to pass into @ref ble_advertising_init.
-    memset(&advdata, 0, sizeof(advdata));
-    advdata.name_type          = BLE_ADVDATA_FULL_NAME;
-    advdata.include_appearance = false;
-    advdata.flags              = BLE_GAP_ADV_FLAGS_LE_ONLY_LIMITED_DISC_MODE;
-    
-    memset(&scanrsp, 0, sizeof(scanrsp));
-    scanrsp.uuids_complete.uuid_cnt = sizeof(m_adv_uuids) / sizeof(m_adv_uuids[0]);
-    scanrsp.uuids_complete.p_uuids  = m_adv_uuids;
+    advdata_build(&advdata, &scanrsp, &manuf_data);
 
-    memset(&options, 0, sizeof(options));
-    options.ble_adv_fast_enabled  = true;
-    options.ble_adv_fast_interval = APP_ADV_INTERVAL;
-    options.ble_adv_fast_timeout  = APP_ADV_TIMEOUT_IN_SECONDS;
+    advertising_modes_get(&options, false);
 
     APP_ERROR_CHECK(ble_advertising_init(&advdata, &scanrsp, &options, on_adv_evt, NULL));
 #endif
@@ -744,10 +1391,22 @@ static void idle_state_handle(void)
 void wdt_event_handler(void)
 {
     //NOTE: The max amount of time we can spend in WDT interrupt is two cycles of 32768[Hz] clock - after that, reset occurs
+    clock_prepare_reset();
     NRF_LOG_ERROR("WDT Rest!\r\n");
     NRF_LOG_FINAL_FLUSH();
 }
 
+#if defined(S112)
+// runs after the config handler, right before the reset
+static bool clock_shutdown_handler(nrf_pwr_mgmt_evt_t event)
+{
+    clock_prepare_reset();
+    return true;
+}
+
+NRF_PWR_MGMT_HANDLER_REGISTER(clock_shutdown_handler, 1);
+#endif
+
 /**@brief Function for application main entry.
  */
 int main(void)
@@ -758,6 +1417,8 @@ int main(void)
     m_resetreas = NRF_POWER->RESETREAS;
     NRF_POWER->RESETREAS |= NRF_POWER->RESETREAS;
     NRF_LOG_DEBUG("== RESET REASON: %d ===\n", m_resetreas);
+    bool clock_valid = clock_restore();
+    energy_init(&m_energy_counters);
 
     NRF_LOG_DEBUG("init..\n");
 
@@ -770,6 +1431,7 @@ int main(void)
     timers_init();
     power_management_init();
     ble_stack_init();
+    boot_phase_end(BOOT_PHASE_STACK);
     scheduler_init();
     gap_params_init();
 #if defined(S112)
@@ -779,6 +1441,7 @@ int main(void)
     ble_options_set();
 #endif
     services_init();
+    boot_phase_end(BOOT_PHASE_SERVICES);
     advertising_init();
     conn_params_init();
 
@@ -788,19 +1451,27 @@ int main(void)
     application_timers_start();
 
     advertising_start();
+    boot_phase_end(BOOT_PHASE_ADVERTISING);
+
+    // blink LED on start
+    led_blink();
 
     NRF_LOG_DEBUG("done.\n");
 
-    if (m_resetreas & NRF_POWER_RESETREAS_DOG_MASK) {
+    // The first display update runs from the scheduler, the tag is connectable in the meantime.
+    if ((m_resetreas & NRF_POWER_RESETREAS_DOG_MASK) && !clock_valid) {
         m_epd.config.display_mode = MODE_CALENDAR;
         ble_epd_on_timer(&m_epd, 0, true);
     } else {
-        ble_epd_on_timer(&m_epd, m_timestamp, true);
+        ble_epd_on_timer(&m_epd, timestamp(), true);
     }
 
     for (;;)
     {
+        uint32_t ticks = app_timer_cnt_get();
         app_sched_execute();
+        ticks = ticks_diff(app_timer_cnt_get(), ticks);
+        energy_add(ENERGY_CPU, (uint32_t)((uint64_t)ticks * 1000000 / TIMER_CLOCK_FREQ));
         idle_state_handle();
     }
 }
@@ -1,6 +1,52 @@
+#ifndef MAIN_H__
+#define MAIN_H__
+
 #include <stdint.h>
+#include "app_timer.h"
+
+#if defined(S112)
+#define TIMER_TICKS(MS)     APP_TIMER_TICKS(MS)
+#define TIMER_CLOCK_FREQ    (APP_TIMER_CLOCK_FREQ / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1))
+#else
+#define APP_TIMER_PRESCALER 0                                  /**< Value of the RTC1 PRESCALER register. */
+#define TIMER_TICKS(MS)     APP_TIMER_TICKS(MS, APP_TIMER_PRESCALER)
+#define TIMER_CLOCK_FREQ    (APP_TIMER_CLOCK_FREQ / (APP_TIMER_PRESCALER + 1))
+#endif
+#define TIMER_MS(TICKS)     ((uint32_t)(((uint64_t)(TICKS) * 1000) / TIMER_CLOCK_FREQ))
+
+// Variables kept across soft resets, validate them before use.
+#if defined(__GNUC__)
+#define NOINIT              __attribute__((section(".noinit")))
+#else
+// placed in the UNINIT region RW_NOINIT of the Keil scatter files
+#define NOINIT              __attribute__((section(".noinit"), zero_init))
+#endif
+
+// Boot phases, each stamped with the RTC1 counter when it ends. RTC1 counts from the
+// LFCLK start inside ble_stack_init, the time before it is not measured.
+typedef enum
+{
+    BOOT_PHASE_STACK = 0,       // SoftDevice enabled
+    BOOT_PHASE_SERVICES,        // GAP, GATT, config and services set up
+    BOOT_PHASE_ADVERTISING,     // first advertisement started
+    BOOT_PHASE_RENDER,          // first display update done
+    BOOT_PHASES,
+} boot_phase_t;
+
+#define BOOT_DATA_LEN       (BOOT_PHASES * 4)
 
 uint32_t timestamp(void);
+uint64_t uptime_ms(void);
 void set_timestamp(uint32_t timestamp);
+void clock_timer_restart(void);
+void clock_prepare_reset(void);
 void sleep_mode_enter(void);
 void app_feed_wdt(void);
+uint32_t ticks_diff(uint32_t ticks_to, uint32_t ticks_from);
+uint8_t *render_arena(uint32_t *size);
+void conn_params_on_transfer(void);
+void advertising_update(void);
+void boot_phase_end(boot_phase_t phase);
+uint16_t boot_encode(uint8_t *buf);
+
+#endif // MAIN_H__
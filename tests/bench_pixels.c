@@ -0,0 +1,82 @@
+// Pixel writer benchmark, run with: make -C tests bench
+// Fills a whole 400x300 frame through GFX_drawPixel, GFX_drawFastHLine and GFX_drawFastVLine
+// for every buffer format and rotation, and prints the best of several runs in pixels per second.
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <time.h>
+#include "Adafruit_GFX.h"
+
+#define WIDTH  400
+#define HEIGHT 300
+#define REPS   20
+#define TRIALS 9
+
+static uint8_t buffer[2 * WIDTH / 8 * HEIGHT];
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// black and red stripes, 16 pixels wide
+#define STRIPE(i) (((i) >> 4) & 1 ? GFX_BLACK : GFX_RED)
+
+static void fill_pixels(Adafruit_GFX *gfx)
+{
+    for (int16_t y = 0; y < gfx->_height; y++)
+        for (int16_t x = 0; x < gfx->_width; x++)
+            GFX_drawPixel(gfx, x, y, STRIPE(x));
+}
+
+static void fill_hlines(Adafruit_GFX *gfx)
+{
+    for (int16_t y = 0; y < gfx->_height; y++)
+        GFX_drawFastHLine(gfx, 0, y, gfx->_width, STRIPE(y));
+}
+
+static void fill_vlines(Adafruit_GFX *gfx)
+{
+    for (int16_t x = 0; x < gfx->_width; x++)
+        GFX_drawFastVLine(gfx, x, 0, gfx->_height, STRIPE(x));
+}
+
+static double measure(Adafruit_GFX *gfx, void (*fill)(Adafruit_GFX *gfx))
+{
+    double best = 1e9;
+    for (int trial = 0; trial < TRIALS; trial++) {
+        double t0 = now();
+        for (int rep = 0; rep < REPS; rep++)
+            fill(gfx);
+        double t = now() - t0;
+        if (t < best) best = t;
+    }
+    return (double)REPS * WIDTH * HEIGHT / best / 1e6;
+}
+
+int main(void)
+{
+    static const char *formats[] = {"bw", "3c", "4c"};
+
+    printf("format rotation  pixel Mpx/s  hline Mpx/s  vline Mpx/s\n");
+    for (int format = 0; format < 3; format++) {
+        for (int rotation = 0; rotation < 4; rotation++) {
+            Adafruit_GFX gfx;
+            if (format == 1)
+                GFX_begin_3c(&gfx, WIDTH, HEIGHT, buffer, sizeof(buffer));
+            else if (format == 2)
+                GFX_begin_4c(&gfx, WIDTH, HEIGHT, buffer, sizeof(buffer));
+            else
+                GFX_begin(&gfx, WIDTH, HEIGHT, buffer, sizeof(buffer));
+            GFX_setRotation(&gfx, (GFX_Rotate)rotation);
+            GFX_firstPage(&gfx);
+            double pixel = measure(&gfx, fill_pixels);
+            double hline = measure(&gfx, fill_hlines);
+            double vline = measure(&gfx, fill_vlines);
+            printf("%-6s %8d  %11.1f  %11.1f  %11.1f\n", formats[format], rotation * 90, pixel, hline, vline);
+            GFX_end(&gfx);
+        }
+    }
+    return 0;
+}
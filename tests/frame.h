@@ -0,0 +1,54 @@
+// Host test helpers: collects the pages DrawGUI hands out into one 400x300 frame
+#ifndef __TEST_FRAME_H
+#define __TEST_FRAME_H
+
+#include <stdint.h>
+#include <string.h>
+#include "GUI.h"
+
+#define FRAME_WIDTH  400
+#define FRAME_HEIGHT 300
+#define FRAME_ROW    (FRAME_WIDTH / 8)
+
+// black and color planes, a 4-color row is split over both
+static uint8_t frame_black[FRAME_HEIGHT][FRAME_ROW], frame_color[FRAME_HEIGHT][FRAME_ROW];
+static uint16_t frame_format;
+
+static void frame_clear(uint16_t color)
+{
+    frame_format = color;
+    memset(frame_black, 0xAA, sizeof(frame_black));
+    memset(frame_color, 0xAA, sizeof(frame_color));
+}
+
+static void frame_draw(uint8_t *black, uint8_t *color, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    uint16_t wb = (w + 7) / 8;
+    for (uint16_t r = 0; r < h; r++) {
+        if (frame_format == 3) {
+            memcpy(&frame_black[y + r][x / 8], black + r * (w / 4), FRAME_ROW);
+            memcpy(&frame_color[y + r][x / 8], black + r * (w / 4) + FRAME_ROW, FRAME_ROW);
+        } else {
+            memcpy(&frame_black[y + r][x / 8], black + r * wb, wb);
+            if (color) memcpy(&frame_color[y + r][x / 8], color + r * wb, wb);
+        }
+    }
+}
+
+// FNV-1a
+#define FRAME_HASH_INIT 1469598103934665603ULL
+
+static uint64_t frame_fnv(const void *data, size_t len, uint64_t hash)
+{
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++)
+        hash = (hash ^ p[i]) * 1099511628211ULL;
+    return hash;
+}
+
+static uint64_t frame_hash(void)
+{
+    return frame_fnv(frame_color, sizeof(frame_color), frame_fnv(frame_black, sizeof(frame_black), FRAME_HASH_INIT));
+}
+
+#endif
@@ -0,0 +1,62 @@
+// Civil date test against the C library.
+// Every day of the 32-bit unix time range (1970-2106), at a varying time of day, is converted
+// by Lunar.c and by gmtime/timegm/strftime. Date, time, weekday, day of year, ISO week and
+// month length must agree, and the conversions back to days and seconds must round trip.
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "Lunar.h"
+
+int main(void)
+{
+    long days_checked = 0;
+    int bad = 0;
+
+    for (uint64_t days = 0; days * SEC_PER_DY <= UINT32_MAX; days++, days_checked++) {
+        uint64_t t64 = days * SEC_PER_DY + (days * 7919) % SEC_PER_DY;
+        uint32_t t = t64 > UINT32_MAX ? UINT32_MAX : (uint32_t)t64;
+
+        time_t tt = t;
+        struct tm g;
+        gmtime_r(&tt, &g);
+
+        // the 32nd day of a month normalizes into the next one
+        struct tm next = g;
+        next.tm_mday = 32;
+        next.tm_hour = 12;
+        timegm(&next);
+        uint8_t month_days = 32 - next.tm_mday;
+
+        char week[4];
+        strftime(week, sizeof(week), "%V", &g);
+
+        tm_t r;
+        transformTime(t, &r);
+        uint16_t year = r.tm_year + YEAR0;
+        uint8_t month = r.tm_mon + 1, day = r.tm_mday;
+        uint16_t cy;
+        uint8_t cm, cd;
+        civil_from_days(days, &cy, &cm, &cd);
+        tm_t back = r; // full year, month from 1
+        back.tm_year = year;
+        back.tm_mon = month;
+
+        if (r.tm_year != g.tm_year || r.tm_mon != g.tm_mon || r.tm_mday != g.tm_mday ||
+            r.tm_hour != g.tm_hour || r.tm_min != g.tm_min || r.tm_sec != g.tm_sec || r.tm_wday != g.tm_wday ||
+            cy != year || cm != month || cd != day ||
+            days_from_civil(year, month, day) != days || weekday_from_days(days) != g.tm_wday ||
+            day_of_week_get(month, day, year) != g.tm_wday ||
+            get_first_day_week(year, month) != (g.tm_wday + 35 - (day - 1)) % 7 ||
+            day_of_year(year, month, day) != g.tm_yday + 1 || iso_week(year, month, day) != atoi(week) ||
+            days_in_month(year, month) != month_days || thisMonthMaxDays(year, month) != month_days ||
+            get_last_day(year, month - 1) != month_days || transformTimeStruct(&back) != t) {
+            if (bad++ < 5)
+                printf("%u: %d-%02d-%02d %02d:%02d:%02d differs from libc\n", t, year, month, day,
+                       r.tm_hour, r.tm_min, r.tm_sec);
+        }
+    }
+
+    printf("civil: %ld days 1970-2106, %s\n", days_checked, bad ? "FAILED" : "OK");
+    return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
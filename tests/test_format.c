@@ -0,0 +1,87 @@
+// GFX_snprintf test against the C library snprintf.
+// Every conversion of the supported subset, with and without the 0 flag and with field
+// widths up to 12, is formatted for edge and pseudo-random values. Output and returned
+// length must match, also when the buffer truncates.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Adafruit_GFX.h"
+
+static int bad;
+
+static void check(const char *format, const char *gfx, size_t gfx_len, const char *libc, int libc_len)
+{
+    if (strcmp(gfx, libc) != 0 || gfx_len != (size_t)libc_len) {
+        if (bad++ < 5)
+            printf("\"%s\": \"%s\" (%u), libc \"%s\" (%d)\n", format, gfx, (unsigned)gfx_len, libc, libc_len);
+    }
+}
+
+#define CHECK(format, ...)                                                     \
+    do {                                                                       \
+        char a[64], b[64];                                                     \
+        size_t n = GFX_snprintf(a, sizeof(a), format, __VA_ARGS__);            \
+        int m = snprintf(b, sizeof(b), format, __VA_ARGS__);                   \
+        check(format, a, n, b, m);                                             \
+    } while (0)
+
+static void check_int(unsigned int v)
+{
+    static const char conversions[] = "diuxX";
+    char format[8];
+
+    for (const char *c = conversions; *c; c++)
+    for (uint8_t zero = 0; zero < 2; zero++)
+    for (uint8_t width = 0; width <= 12; width++) {
+        if (width == 0)
+            snprintf(format, sizeof(format), "%%%c", *c);
+        else
+            snprintf(format, sizeof(format), zero ? "%%0%d%c" : "%%%d%c", width, *c);
+        CHECK(format, v);
+    }
+}
+
+int main(void)
+{
+    static const unsigned int edges[] = {0, 1, 9, 10, 99, 100, 2930, 65535, 65536, 0x7FFFFFFF,
+                                         0x80000000, 0xFFFFFFFF, (unsigned)-1, (unsigned)-10, (unsigned)-2930};
+    char format[8];
+    uint32_t seed = 1;
+
+    for (uint8_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++)
+        check_int(edges[i]);
+    for (int i = 0; i < 20000; i++) {
+        seed = seed * 1103515245u + 12345u;
+        check_int(seed >> (seed % 32));
+    }
+
+    for (int c = 1; c < 256; c++)
+        CHECK("%c", c);
+    for (uint8_t width = 0; width <= 12; width++) {
+        snprintf(format, sizeof(format), "%%%ds|", width);
+        CHECK(format, "");
+        CHECK(format, "abc");
+        CHECK(format, "NRF_EPD_84AC");
+        CHECK(format, "离春分");
+    }
+    CHECK("%s-%c-%%", "abc", 'z');
+    CHECK("%d.%dV", 2, 9);
+    CHECK("%04d-%02d-%02d %02d:%02d", 2025, 1, 1, 9, 5);
+    CHECK("离%d天", 12);
+
+    // truncated output is cut like snprintf, the full length is returned
+    for (size_t size = 0; size <= 12; size++) {
+        char a[16], b[16];
+        memset(a, 'x', sizeof(a));
+        memset(b, 'x', sizeof(b));
+        size_t n = GFX_snprintf(a, size, "%d-%02d|%s", 2025, 7, "abc");
+        int m = snprintf(b, size, "%d-%02d|%s", 2025, 7, "abc");
+        if (n != (size_t)m || memcmp(a, b, sizeof(a)) != 0) {
+            if (bad++ < 5)
+                printf("truncated to %u: %u, libc %d\n", (unsigned)size, (unsigned)n, m);
+        }
+    }
+
+    printf("format: %s\n", bad ? "FAILED" : "OK");
+    return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,82 @@
+// Month table test over 2000-2100.
+// Stepping the lunar date a day at a time from the 1st, as the month table does, must give
+// the same date as a full conversion on every day (no lunar date past the tables, 2050), and
+// the calendar frames drawn from the month table on the 1st, 15th and 29th of every month
+// must match the golden hash.
+#include <stdio.h>
+#include <stdlib.h>
+#include "Lunar.h"
+#include "frame.h"
+
+#define GOLDEN 0xed5804ddf15d9f06ULL
+
+static uint32_t arena[(DISPLAY_LIST_SIZE + 2 * FRAME_ROW * FRAME_HEIGHT) / 4];
+
+static int check_lunar(void)
+{
+    struct Lunar_Date next = {0}, lunar;
+    uint32_t first = days_from_civil(2000, 1, 1), last = days_from_civil(2100, 12, 31);
+    uint16_t year;
+    uint8_t month, day;
+    int bad = 0;
+
+    for (uint32_t days = first; days <= last; days++) {
+        civil_from_days(days, &year, &month, &day);
+        if (day == 1)
+            LUNAR_SolarToLunar(&next, year, month, day);
+        LUNAR_SolarToLunar(&lunar, year, month, day);
+        if (memcmp(&lunar, &next, sizeof(lunar)) != 0) {
+            if (bad++ < 5)
+                printf("%d-%02d-%02d: next day %d-%d-%d leap %d, converted %d-%d-%d leap %d\n", year, month, day,
+                       next.Year, next.Month, next.Date, next.IsLeap,
+                       lunar.Year, lunar.Month, lunar.Date, lunar.IsLeap);
+            next = lunar;
+        }
+        LUNAR_NextDay(&next);
+    }
+    return bad;
+}
+
+static int check_frames(void)
+{
+    uint64_t all = FRAME_HASH_INIT;
+    uint32_t first = days_from_civil(2000, 1, 1), last = days_from_civil(2100, 12, 31);
+    uint16_t year;
+    uint8_t month, day;
+
+    for (uint32_t days = first; days <= last; days++) {
+        civil_from_days(days, &year, &month, &day);
+        if (day != 1 && day != 15 && day != 29) continue;
+        for (uint8_t week_start = 0; week_start < 2; week_start++) {
+            gui_data_t data = {
+                .color = 2,
+                .width = FRAME_WIDTH,
+                .height = FRAME_HEIGHT,
+                .timestamp = days * SEC_PER_DY + SEC_PER_HR,
+                .week_start = week_start,
+                .temperature = 23,
+                .voltage = 2930,
+                .battery = 81,
+                .ssid = "NRF_EPD_84AC",
+                .arena = (uint8_t *)arena,
+                .arena_size = sizeof(arena),
+            };
+            frame_clear(data.color);
+            DrawGUI(&data, frame_draw, MODE_CALENDAR);
+            uint64_t hash = frame_hash();
+            all = frame_fnv(&hash, sizeof(hash), all);
+        }
+    }
+    if (all != GOLDEN) {
+        printf("frames hash %016llx, golden %016llx\n", (unsigned long long)all, GOLDEN);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    int bad = check_lunar() + check_frames();
+    printf("months: 2000-2100, %s\n", bad ? "FAILED" : "OK");
+    return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
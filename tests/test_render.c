@@ -0,0 +1,119 @@
+// Golden-image test of the GUI renderer.
+// Calendar and clock are drawn for every panel color and week start on a set of dates, with
+// render arenas from a few rows per page to a whole frame, and with a saved calendar layer.
+// Every arena must give the same frames, and their hash must match the golden one.
+#include <stdio.h>
+#include <stdlib.h>
+#include "frame.h"
+
+#define GOLDEN 0xa09116db288376ecULL
+
+static const uint32_t dates[] = {
+    1735689600, // 2025-01-01 00:00
+    1751375220, // 2025-07-01 13:07
+    1760745600, // 2025-10-18
+    1738108800, // 2025-01-29, Spring Festival
+    1772236800, // 2026-02-28
+    1893456000, // 2030-01-01
+    1707696000, // 2024-02-12
+};
+#define DATES (sizeof(dates) / sizeof(dates[0]))
+#define CASES (3 * 2 * 2 * DATES)
+
+static const uint32_t arena_sizes[] = {1024, 3000, 9216, 30000, DISPLAY_LIST_SIZE + 30000};
+#define ARENAS (sizeof(arena_sizes) / sizeof(arena_sizes[0]))
+
+static uint32_t arena[(DISPLAY_LIST_SIZE + 30000) / 4];
+
+// calendar layer kept in RAM instead of flash
+static uint16_t layer[4096];
+static uint16_t layer_words;
+static int layer_open, layer_saves, layer_loads;
+
+static const uint16_t *layer_load(uint16_t *words)
+{
+    if (layer_words == 0) return NULL;
+    layer_open++;
+    layer_loads++;
+    *words = layer_words;
+    return layer;
+}
+
+static void layer_close(void)
+{
+    layer_open--;
+}
+
+static void layer_save(const uint16_t *data, uint16_t words)
+{
+    if (layer_open) printf("layer saved while open\n");
+    if (words > sizeof(layer) / sizeof(layer[0])) return;
+    memcpy(layer, data, words * sizeof(uint16_t));
+    layer_words = words;
+    layer_saves++;
+}
+
+static const gui_layer_store_t layer_store = {layer_load, layer_close, layer_save};
+
+// renders all cases, returns the number of frames that differ from ref (filled when NULL)
+static int render_all(uint32_t arena_size, const gui_layer_store_t *store, uint64_t *hashes, const uint64_t *ref)
+{
+    int bad = 0, n = 0;
+    for (uint16_t color = 1; color <= 3; color++)
+    for (int mode = MODE_CALENDAR; mode <= MODE_CLOCK; mode++)
+    for (uint8_t week_start = 0; week_start < 2; week_start++)
+    for (uint8_t i = 0; i < DATES; i++, n++) {
+        gui_data_t data = {
+            .color = color,
+            .width = FRAME_WIDTH,
+            .height = FRAME_HEIGHT,
+            .timestamp = dates[i],
+            .week_start = week_start,
+            .temperature = 23,
+            .voltage = 2930,
+            .battery = 81,
+            .ssid = "NRF_EPD_84AC",
+            .arena = (uint8_t *)arena,
+            .arena_size = arena_size,
+            .layer_store = store,
+        };
+        frame_clear(color);
+        DrawGUI(&data, frame_draw, (display_mode_t)mode);
+        hashes[n] = frame_hash();
+        if (ref != NULL && hashes[n] != ref[n]) {
+            printf("arena %u%s: color=%d mode=%d week_start=%d time=%u differs\n", arena_size,
+                   store ? " with layer" : "", color, mode, week_start, dates[i]);
+            bad++;
+        }
+    }
+    return bad;
+}
+
+int main(void)
+{
+    static uint64_t ref[CASES], hashes[CASES];
+    int bad = 0;
+
+    render_all(arena_sizes[0], NULL, ref, NULL);
+    for (uint8_t i = 1; i < ARENAS; i++)
+        bad += render_all(arena_sizes[i], NULL, hashes, ref);
+
+    // the first calendar of each month saves the layer, the rest replay it
+    bad += render_all(9216, &layer_store, hashes, ref);
+    bad += render_all(9216, &layer_store, hashes, ref);
+    if (layer_saves == 0 || layer_loads == 0 || layer_open != 0) {
+        printf("calendar layer: %d saves, %d loads, %d open\n", layer_saves, layer_loads, layer_open);
+        bad++;
+    }
+
+    uint64_t all = FRAME_HASH_INIT;
+    for (int i = 0; i < CASES; i++)
+        all = frame_fnv(&ref[i], sizeof(ref[i]), all);
+    if (all != GOLDEN) {
+        printf("frames hash %016llx, golden %016llx\n", (unsigned long long)all, GOLDEN);
+        bad++;
+    }
+
+    printf("render: %d frames x %d arenas, %s\n", (int)CASES, (int)ARENAS + 2, bad ? "FAILED" : "OK");
+    return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""
+Generate the glyph lookup index for the u8g2 fonts in GUI/fonts.c.
+
+u8g2_font_get_glyph_data() finds a glyph by walking the glyph records of the
+font one by one. This script lists the glyphs of every font array in fonts.c
+and appends a sorted encoding -> offset table per font, which u8g2_font.c
+searches with a binary search instead. Fonts missing from the index are
+still found by the scan.
+
+The advance, width and x offset of every glyph are listed as well, so text
+can be measured without decoding the glyph headers.
+
+Run it again whenever fonts.c is regenerated with bdfconv:
+
+    python tools/font_index.py GUI/fonts.c
+"""
+
+import re
+import sys
+
+BEGIN = "/* BEGIN font index, generated by tools/font_index.py, do not edit */"
+END = "/* END font index */"
+
+FONT_RE = re.compile(r'const uint8_t (\w+)\[(\d+)\][^=]*=\s*((?:"(?:[^"\\]|\\.)*"\s*)+);')
+STRING_RE = re.compile(r'"((?:[^"\\]|\\.)*)"')
+ESCAPE_RE = re.compile(r'\\([0-7]{1,3}|.)')
+ESCAPES = {'n': 10, 't': 9, 'r': 13, '\\': 92, '"': 34, "'": 39, '?': 63}
+
+
+def c_string_bytes(literal):
+    data = bytearray()
+    for part in STRING_RE.findall(literal):
+        pos = 0
+        for m in ESCAPE_RE.finditer(part):
+            data += part[pos:m.start()].encode('latin-1')
+            esc = m.group(1)
+            data.append(int(esc, 8) if esc[0] in '01234567' else ESCAPES[esc])
+            pos = m.end()
+        data += part[pos:].encode('latin-1')
+    return bytes(data) + b"\0"  # the array includes the terminating NUL
+
+
+def word(font, pos):
+    return (font[pos] << 8) | font[pos + 1]
+
+
+class BitReader:
+    """Reads the glyph header fields like u8g2_font_decode_get_unsigned_bits()."""
+
+    def __init__(self, font, pos):
+        self.font = font
+        self.pos = pos
+        self.bit = 0
+
+    def unsigned(self, cnt):
+        value = 0
+        for i in range(cnt):
+            value |= ((self.font[self.pos] >> self.bit) & 1) << i
+            self.bit += 1
+            if self.bit == 8:
+                self.bit = 0
+                self.pos += 1
+        return value
+
+    def signed(self, cnt):
+        return self.unsigned(cnt) - (1 << (cnt - 1))
+
+
+def metrics(font, pos):
+    """(advance, width, x offset) from the header of the glyph data at pos."""
+    bits = BitReader(font, pos)
+    width = bits.unsigned(font[4])
+    bits.unsigned(font[5])  # height
+    x = bits.signed(font[6])
+    bits.signed(font[7])    # y offset
+    return bits.signed(font[8]), width, x
+
+
+def glyphs(font):
+    """Yield (encoding, offset of the glyph data) for every glyph of the font."""
+    # glyphs up to 255: encoding, size, data
+    pos = 23
+    while font[pos + 1] != 0:
+        yield font[pos], pos + 2
+        pos += font[pos + 1]
+
+    # unicode glyphs: jump table, then encoding (2 bytes), size, data
+    table = 23 + word(font, 21)
+    pos = table + word(font, table)
+    while word(font, pos) != 0:
+        yield word(font, pos), pos + 3
+        pos += font[pos + 2]
+
+
+def index_source(fonts):
+    lines = [BEGIN, ""]
+    entries = []
+    for name, font in fonts:
+        index = sorted(glyphs(font))
+        if len(font) > 0xFFFF:
+            sys.exit("%s: offsets do not fit in 16 bits" % name)
+        for suffix, column in (("encoding", 0), ("offset", 1)):
+            lines.append("static const uint16_t %s_%s[%d] = {" % (name, suffix, len(index)))
+            values = ["%d" % glyph[column] for glyph in index]
+            for i in range(0, len(values), 16):
+                lines.append("  " + ",".join(values[i:i + 16]) + ",")
+            lines.append("};")
+        lines.append("static const u8g2_glyph_metrics_t %s_metrics[%d] = {" % (name, len(index)))
+        values = ["{%d,%d,%d}" % metrics(font, glyph[1]) for glyph in index]
+        for i in range(0, len(values), 8):
+            lines.append("  " + ",".join(values[i:i + 8]) + ",")
+        lines.append("};")
+        entries.append("  {%s, %s_encoding, %s_offset, %s_metrics, %d},"
+                       % (name, name, name, name, len(index)))
+        lines.append("")
+
+    lines.append("const u8g2_font_index_t u8g2_font_index[] = {")
+    lines += entries
+    lines.append("  {NULL, NULL, NULL, NULL, 0},")
+    lines.append("};")
+    lines.append(END)
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else "GUI/fonts.c"
+    with open(path, encoding="utf-8") as f:
+        source = f.read()
+
+    start = source.find(BEGIN)
+    if start >= 0:
+        source = source[:start].rstrip("\n") + "\n"
+
+    fonts = []
+    for m in FONT_RE.finditer(source):
+        font = c_string_bytes(m.group(3))
+        if len(font) != int(m.group(2)):
+            sys.exit("%s: parsed %d bytes, expected %s" % (m.group(1), len(font), m.group(2)))
+        fonts.append((m.group(1), font))
+
+    index = index_source(fonts)
+    with open(path, "w", encoding="utf-8", newline="\n") as f:
+        f.write(source + "\n" + index)
+    print("%s: indexed %s" % (path, ", ".join(name for name, _ in fonts)))
+
+
+if __name__ == "__main__":
+    main()